@@ -0,0 +1,142 @@
+/*
+ * Tests for BasicParticleSystem. The system itself is a template, so it all
+ * lives in BasicParticleSystem.h.
+ */
+#include "BasicParticleSystem.h"
+#include "ParticleSystem.h"
+#include "Demos/ParticleCatcher.h"
+using namespace std;
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("gravity behavior matches ballistic particles") {
+    BasicParticleSystem<Gravity<1>, CullOutOfBounds> system;
+    ParticleSystem reference;
+
+    Particle ballistic;
+    ballistic.type = ParticleType::BALLISTIC;
+    ballistic.y = 100;
+    ballistic.dx = 1;
+    ballistic.dy = -10;
+    system.add(ballistic);
+    reference.add(ballistic);
+
+    /* Fly until the particle falls out of the bottom of the scene. */
+    for (int step = 0; step < 60; step++) {
+        EXPECT_EQUAL(system.numParticles(), reference.numParticles());
+        if (system.numParticles() == 1) {
+            const ParticleStore& expected = reference.bucket(ParticleType::BALLISTIC);
+            EXPECT_EQUAL(system._particles.x[0], expected.x[0]);
+            EXPECT_EQUAL(system._particles.y[0], expected.y[0]);
+            EXPECT_EQUAL(system._particles.dy[0], expected.dy[0]);
+        }
+        system.moveParticles();
+        reference.moveParticles();
+    }
+    EXPECT_EQUAL(system.numParticles(), 0);
+}
+
+STUDENT_TEST("particles with no bounds behavior are only removed when they expire") {
+    BasicParticleSystem<> system;
+
+    Particle particle;
+    particle.x = 1;
+    particle.y = 1;
+    particle.dx = -5;
+    particle.lifetime = 3;
+    system.add(particle);
+
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQUAL(system.numParticles(), 1);
+        system.moveParticles();
+    }
+    EXPECT_EQUAL(system.numParticles(), 0);
+}
+
+STUDENT_TEST("wrapping particles come back on the other side") {
+    BasicParticleSystem<WrapAround> system;
+
+    Particle particle;
+    particle.x = 1;
+    particle.y = SCENE_HEIGHT - 1;
+    particle.dx = -3;
+    particle.dy = 2;
+    system.add(particle);
+    system.moveParticles();
+
+    ParticleCatcher catcher;
+    system.drawParticles();
+    EXPECT_EQUAL(catcher.numDrawn(), 1);
+    EXPECT_EQUAL(catcher[0].x, SCENE_WIDTH - 2);
+    EXPECT_EQUAL(catcher[0].y, 1);
+}
+
+STUDENT_TEST("exploding fireworks spawn streamers after the tick") {
+    BasicParticleSystem<Gravity<1>, CullOutOfBounds, FireworkExplosion> system;
+
+    Particle firework;
+    firework.type = ParticleType::FIREWORK;
+    firework.lifetime = 0;
+    firework.x = 100;
+    firework.y = 100;
+    system.add(firework);
+
+    system.moveParticles();
+    EXPECT_EQUAL(system.numParticles(), 50);
+
+    /* The streamers haven't moved yet, and all share a color. */
+    Color color = system._particles.color[0];
+    for (int i = 0; i < system.numParticles(); i++) {
+        EXPECT_EQUAL(system._particles.type[i], ParticleType::STREAMER);
+        EXPECT_EQUAL(system._particles.color[i], color);
+        EXPECT_EQUAL(system._particles.x[i], 100);
+    }
+
+    /* Streamers don't explode when they expire. */
+    for (int i = 0; i < 12; i++) {
+        system.moveParticles();
+    }
+    EXPECT_EQUAL(system.numParticles(), 0);
+}
+
+STUDENT_TEST("compact particle system moves particles like the full-size one") {
+    CompactParticleSystem<Gravity<1>, CullOutOfBounds, FireworkExplosion> compact;
+    BasicParticleSystem<Gravity<1>, CullOutOfBounds, FireworkExplosion> full;
+    compact.seed(5);
+    full.seed(5);
+
+    /* Whole numbers and halves are exact in a float, and the lifetimes fit
+     * in 16 bits.
+     */
+    for (int i = 0; i < 20; i++) {
+        Particle particle;
+        particle.x = 10 + 30 * i;
+        particle.y = 300.5;
+        particle.dx = i % 5 - 2;
+        particle.dy = -i;
+        particle.lifetime = i % 3 == 0 ? 10 : 10000;
+        particle.type = i % 3 == 0 ? ParticleType::FIREWORK : ParticleType::BALLISTIC;
+        particle.color = Color(i, 2 * i, 3 * i);
+        compact.add(particle);
+        full.add(particle);
+    }
+
+    for (int step = 0; step < 12; step++) {
+        compact.moveParticles();
+        full.moveParticles();
+        EXPECT_EQUAL(compact.numParticles(), full.numParticles());
+        for (int i = 0; i < full.numParticles(); i++) {
+            EXPECT_EQUAL(compact._particles.get(i), full._particles.get(i));
+        }
+    }
+
+    /* Drawing hands over ordinary doubles and Colors. */
+    ParticleCatcher catcher;
+    compact.drawParticles();
+    EXPECT_EQUAL(catcher.numDrawn(), full.numParticles());
+    EXPECT(catcher.numDrawn() > 0);
+    for (int i = 0; i < catcher.numDrawn(); i++) {
+        EXPECT_EQUAL(catcher[i].x, full._particles.x[i]);
+        EXPECT_EQUAL(catcher[i].color, full._particles.color[i]);
+    }
+}
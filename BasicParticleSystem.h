@@ -0,0 +1,208 @@
+/******************************************************************************
+ * File: BasicParticleSystem.h
+ *
+ * A particle system whose rules are chosen at compile time. Rather than
+ * looking at each particle's type, every particle follows the behaviors
+ * listed as template arguments (see ParticleBehaviors.h). For example,
+ *
+ *     BasicParticleSystem<Gravity<1>, CullOutOfBounds> water;
+ *
+ * is a system of ballistic particles that disappear when they leave the
+ * scene, with no firework logic compiled in at all. The particle's type
+ * field is ignored except by ExplodeOnExpire, which only explodes
+ * fireworks.
+ *
+ * The particles are kept in a ParticleStore. CompactParticleSystem is the
+ * same thing with a CompactParticleStore, which uses floats and packed
+ * colors to fit about twice as many particles in the same memory:
+ *
+ *     CompactParticleSystem<Gravity<1>, CullOutOfBounds> water;
+ */
+#pragma once
+
+#include "ParticleBehaviors.h"
+#include "ParticleStore.h"
+#include "CompactParticleStore.h"
+#include "ParticleRandom.h"
+#include "DrawParticle.h"
+#include "GUI/SimpleTest.h"
+#include <type_traits>
+
+template <typename Store, typename... Behaviors> class StoredParticleSystem {
+public:
+    static_assert((std::is_base_of<ParticleBehavior, Behaviors>::value && ...),
+                  "Behaviors must derive from ParticleBehavior.");
+
+    /* Adds a new particle. If the particle is outside the scene or has a
+     * negative lifetime, has no effect.
+     */
+    void add(Particle particle);
+
+    /* Adds 'count' particles, calling generate(particle) to fill in each
+     * one. The particles are written straight into storage and then checked
+     * as a batch; invalid ones are dropped, as with add.
+     */
+    template <typename Generator> void emit(int count, Generator generate);
+
+    /* Runs 'numTrials' trials that each succeed with the given probability,
+     * and adds a particle for each success by calling
+     * generate(particle, trial). The cost depends on how many particles are
+     * made, not how many trials there are. Invalid particles are dropped.
+     */
+    template <typename Generator>
+    void emitSparse(int numTrials, double probability, Generator generate);
+
+    /* Returns how many particles are in the system. */
+    int numParticles() const;
+
+    /* Makes room for at least the given number of particles. */
+    void reserve(int numParticles);
+
+    /* Draws all the particles in the order they were added. */
+    void drawParticles() const;
+
+    /* Moves every particle one step and applies the behaviors. Particles
+     * whose lifetimes run out or that a behavior says are out of bounds are
+     * removed. Particles spawned by a behavior are added at the end of the
+     * tick and first move on the next one.
+     */
+    void moveParticles();
+
+    /* Restarts the system's random number generator from the given seed.
+     * Without a call to seed, each system is seeded randomly.
+     */
+    void seed(uint64_t seed);
+
+    /* Returns the system's random number generator, which behaviors use and
+     * scenes can use to create particles (see ParticleRandom.h).
+     */
+    ParticleRandom& random();
+
+    /* Sets the region particles live in. Particles outside it are not added,
+     * and CullOutOfBounds removes particles that leave it. The default is
+     * the scene, [0, SCENE_WIDTH) x [0, SCENE_HEIGHT).
+     */
+    void setBounds(const ParticleBounds& bounds);
+    ParticleBounds bounds() const;
+
+private:
+    Store _particles;
+    Store _spawned; // Particles spawned during the current tick
+    ParticleRandom _random;
+    ParticleBounds _bounds;
+
+    bool outOfBounds(int index) const;
+
+    ALLOW_TEST_ACCESS();
+};
+
+/* A particle system that stores particles at full precision. */
+template <typename... Behaviors>
+using BasicParticleSystem = StoredParticleSystem<ParticleStore, Behaviors...>;
+
+/* A particle system that stores particles compactly. */
+template <typename... Behaviors>
+using CompactParticleSystem = StoredParticleSystem<CompactParticleStore, Behaviors...>;
+
+/* * * * * Implementation Below This Point * * * * */
+
+template <typename Store, typename... Behaviors>
+void StoredParticleSystem<Store, Behaviors...>::add(Particle particle) {
+    if (particle.lifetime < 0 || !_bounds.contains(particle.x, particle.y)) {
+        return;
+    }
+    _particles.push(particle);
+}
+
+template <typename Store, typename... Behaviors>
+template <typename Generator>
+void StoredParticleSystem<Store, Behaviors...>::emit(int count, Generator generate) {
+    int first = _particles.emit(count, generate);
+    _particles.removeInvalid(first, _bounds);
+}
+
+template <typename Store, typename... Behaviors>
+template <typename Generator>
+void StoredParticleSystem<Store, Behaviors...>::emitSparse(int numTrials, double probability, Generator generate) {
+    int first = _particles.size();
+    _random.forEachSuccess(numTrials, probability, [&](int trial) {
+        Particle particle;
+        generate(particle, trial);
+        _particles.push(particle);
+    });
+    _particles.removeInvalid(first, _bounds);
+}
+
+template <typename Store, typename... Behaviors>
+int StoredParticleSystem<Store, Behaviors...>::numParticles() const {
+    return _particles.size();
+}
+
+template <typename Store, typename... Behaviors>
+void StoredParticleSystem<Store, Behaviors...>::reserve(int numParticles) {
+    _particles.reserve(numParticles);
+}
+
+template <typename Store, typename... Behaviors>
+void StoredParticleSystem<Store, Behaviors...>::drawParticles() const {
+    drawParticleBatch(_particles.x.data(), _particles.y.data(), _particles.color.data(), _particles.size());
+}
+
+template <typename Store, typename... Behaviors>
+bool StoredParticleSystem<Store, Behaviors...>::outOfBounds(int index) const {
+    (void) index; // Unused if there are no behaviors
+    return (Behaviors::outOfBounds(_particles, index, _bounds) || ...);
+}
+
+template <typename Store, typename... Behaviors>
+void StoredParticleSystem<Store, Behaviors...>::moveParticles() {
+    /* One pass moves each particle, applies every behavior, and slides the
+     * survivors down over the particles that were removed.
+     */
+    int numKept = 0;
+    for (int i = 0; i < _particles.size(); i++) {
+        _particles.x[i] += _particles.dx[i];
+        _particles.y[i] += _particles.dy[i];
+        _particles.lifetime[i]--;
+        (Behaviors::update(_particles, i), ...);
+
+        if (_particles.lifetime[i] < 0) {
+            (Behaviors::expire(_particles, i, _spawned, _random), ...);
+        }
+        else if (!outOfBounds(i)) {
+            if (numKept != i) {
+                _particles.move(i, numKept);
+            }
+            numKept++;
+        }
+    }
+    _particles.resize(numKept);
+
+    int first = _particles.size();
+    _particles.reserveMore(_spawned.size());
+    for (int i = 0; i < _spawned.size(); i++) {
+        _particles.push(_spawned.get(i));
+    }
+    _particles.removeInvalid(first, _bounds);
+    _spawned.clear();
+}
+
+template <typename Store, typename... Behaviors>
+void StoredParticleSystem<Store, Behaviors...>::seed(uint64_t seed) {
+    _random.seed(seed);
+}
+
+template <typename Store, typename... Behaviors>
+ParticleRandom& StoredParticleSystem<Store, Behaviors...>::random() {
+    return _random;
+}
+
+template <typename Store, typename... Behaviors>
+void StoredParticleSystem<Store, Behaviors...>::setBounds(const ParticleBounds& bounds) {
+    _bounds = bounds;
+}
+
+template <typename Store, typename... Behaviors>
+ParticleBounds StoredParticleSystem<Store, Behaviors...>::bounds() const {
+    return _bounds;
+}
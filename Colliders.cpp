@@ -0,0 +1,303 @@
+#include "Colliders.h"
+#include "GUI/SimpleTest.h"
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+bool Collider::contains(double px, double py) const {
+    return px >= x && px < x + width && py >= y && py < y + height;
+}
+
+namespace {
+    /* Reflects 'position' off an edge at 'low' or 'high', whichever the
+     * particle came through, making sure it ends up outside [low, high).
+     */
+    double reflect(double position, double previous, double low, double high) {
+        if (previous < low) {
+            return min(2 * low - position, nextafter(low, -INFINITY));
+        }
+        return max(2 * high - position, high);
+    }
+
+    /* Works out when a move from 'from' to 'to' along one axis is within
+     * [low, high), as fractions of the move: it's inside from 'enter' to
+     * 'exit'. A move that stands still along the axis is inside either
+     * always or never.
+     */
+    void slab(double from, double to, double low, double high, double& enter, double& exit) {
+        double delta = to - from;
+        if (delta == 0) {
+            bool inside = from >= low && from < high;
+            enter = inside ? -INFINITY : INFINITY;
+            exit  = inside ? INFINITY : -INFINITY;
+            return;
+        }
+        double toLow = (low - from) / delta;
+        double toHigh = (high - from) / delta;
+        enter = min(toLow, toHigh);
+        exit = max(toLow, toHigh);
+    }
+}
+
+double Collider::hitTime(double prevX, double prevY, double px, double py) const {
+    double enterX, exitX, enterY, exitY;
+    slab(prevX, px, x, x + width, enterX, exitX);
+    slab(prevY, py, y, y + height, enterY, exitY);
+
+    double enter = max(max(enterX, enterY), 0.0);
+    double exit = min(min(exitX, exitY), 1.0);
+    if (enter < exit || contains(px, py)) {
+        return enter;
+    }
+    return -1;
+}
+
+void Collider::respond(double& px, double& py, double& dx, double& dy, double prevX, double prevY) const {
+    if (contains(prevX, prevY)) return;
+
+    /* The particle came in through whichever pair of sides it crossed
+     * last.
+     */
+    double enterX, exitX, enterY, exitY;
+    slab(prevX, px, x, x + width, enterX, exitX);
+    slab(prevY, py, y, y + height, enterY, exitY);
+
+    if (response == CollisionResponse::STICK) {
+        px = prevX;
+        py = prevY;
+        dx = 0;
+        dy = 0;
+    }
+    else if (enterX > enterY) {
+        /* Came in through the left or right side. */
+        px = reflect(px, prevX, x, x + width);
+        dx = -dx * bounciness;
+    }
+    else {
+        /* Came in through the top or bottom. */
+        py = reflect(py, prevY, y, y + height);
+        dy = -dy * bounciness;
+    }
+}
+
+namespace {
+    /* Splits [low, high) into cells about 'cellSize' wide, but no more than
+     * 'maxCells' of them. Returns the number of cells and sets their width.
+     */
+    int divide(double low, double high, double cellSize, int maxCells, double& width) {
+        int numCells = int(max(1.0, min(ceil((high - low) / cellSize), double(maxCells))));
+        width = max((high - low) / numCells, cellSize);
+        return numCells;
+    }
+}
+
+int ColliderSet::colOf(double x) const {
+    return int(max(0.0, min(floor((x - _minX) / _cellWidth), double(_numCols - 1))));
+}
+
+int ColliderSet::rowOf(double y) const {
+    return int(max(0.0, min(floor((y - _minY) / _cellHeight), double(_numRows - 1))));
+}
+
+void ColliderSet::setBounds(const ParticleBounds& bounds) {
+    _bounds = bounds;
+    rebuild();
+}
+
+void ColliderSet::add(const Collider& collider) {
+    _colliders.push_back(collider);
+    rebuild();
+}
+
+/* Lays the grid out again and files every rectangle in it. There are only
+ * ever a handful of rectangles, so this is cheap.
+ */
+void ColliderSet::rebuild() {
+    _cells.clear();
+    if (_colliders.empty()) return;
+
+    /* Open sides of the bounds stop at the farthest rectangle. */
+    double lowX = INFINITY, lowY = INFINITY, highX = -INFINITY, highY = -INFINITY;
+    for (const Collider& collider: _colliders) {
+        lowX = min(lowX, collider.x);
+        lowY = min(lowY, collider.y);
+        highX = max(highX, collider.x + collider.width);
+        highY = max(highY, collider.y + collider.height);
+    }
+    double minX = isinf(_bounds.minX) ? lowX : _bounds.minX;
+    double minY = isinf(_bounds.minY) ? lowY : _bounds.minY;
+    double maxX = isinf(_bounds.maxX) ? highX : _bounds.maxX;
+    double maxY = isinf(_bounds.maxY) ? highY : _bounds.maxY;
+
+    _minX = minX;
+    _minY = minY;
+    _numCols = divide(minX, maxX, kCellSize, kMaxCellsPerSide, _cellWidth);
+    _numRows = divide(minY, maxY, kCellSize, kMaxCellsPerSide, _cellHeight);
+    _cells.resize(_numCols * _numRows);
+
+    for (int index = 0; index < int(_colliders.size()); index++) {
+        const Collider& collider = _colliders[index];
+        int lastCol = colOf(collider.x + collider.width);
+        int lastRow = rowOf(collider.y + collider.height);
+        for (int row = rowOf(collider.y); row <= lastRow; row++) {
+            for (int col = colOf(collider.x); col <= lastCol; col++) {
+                _cells[row * _numCols + col].push_back(index);
+            }
+        }
+    }
+}
+
+void ColliderSet::clear() {
+    _colliders.clear();
+    _cells.clear();
+}
+
+int ColliderSet::size() const {
+    return _colliders.size();
+}
+
+bool ColliderSet::isEmpty() const {
+    return _colliders.empty();
+}
+
+const Collider& ColliderSet::operator[](int index) const {
+    return _colliders[index];
+}
+
+int ColliderSet::find(double x, double y) const {
+    if (_colliders.empty()) return -1;
+
+    for (int index: _cells[rowOf(y) * _numCols + colOf(x)]) {
+        if (_colliders[index].contains(x, y)) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+int ColliderSet::findHit(double prevX, double prevY, double x, double y) const {
+    if (_colliders.empty()) return -1;
+
+    /* Every cell in the box around the move. A rectangle overlapping
+     * several of them is checked more than once, which gives the same
+     * answer.
+     */
+    int best = -1;
+    double bestTime = INFINITY;
+    int lastCol = colOf(max(prevX, x));
+    int lastRow = rowOf(max(prevY, y));
+    for (int row = rowOf(min(prevY, y)); row <= lastRow; row++) {
+        for (int col = colOf(min(prevX, x)); col <= lastCol; col++) {
+            for (int index: _cells[row * _numCols + col]) {
+                double time = _colliders[index].hitTime(prevX, prevY, x, y);
+                if (time >= 0 && (time < bestTime || (time == bestTime && index < best))) {
+                    best = index;
+                    bestTime = time;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("collider set finds the rectangle a point is in") {
+    ColliderSet colliders;
+    EXPECT_EQUAL(colliders.find(10, 10), -1);
+
+    colliders.add({ 100, 100, 50, 20, CollisionResponse::ABSORB, 1 });
+    colliders.add({ 120, 110, 300, 300, CollisionResponse::BOUNCE, 1 });
+    colliders.add({ -100, -100, 50, 50, CollisionResponse::STICK, 1 }); // Off the scene
+    EXPECT_EQUAL(colliders.size(), 3);
+
+    EXPECT_EQUAL(colliders.find(100, 100), 0);
+    EXPECT_EQUAL(colliders.find(149, 119), 0);  // In both; the first one wins
+    EXPECT_EQUAL(colliders.find(150, 119), 1);
+    EXPECT_EQUAL(colliders.find(419, 409), 1);
+    EXPECT_EQUAL(colliders.find(420, 409), -1);
+    EXPECT_EQUAL(colliders.find(99, 100), -1);
+    EXPECT_EQUAL(colliders.find(-75, -75), 2);
+    EXPECT_EQUAL(colliders.find(-25, -75), -1);
+
+    colliders.clear();
+    EXPECT(colliders.isEmpty());
+    EXPECT_EQUAL(colliders.find(100, 100), -1);
+}
+
+STUDENT_TEST("colliders bounce particles off the side they came in through") {
+    Collider wall = { 100, 100, 50, 50, CollisionResponse::BOUNCE, 0.5 };
+
+    /* From above. */
+    double x = 120, y = 103, dx = 1, dy = 8;
+    wall.respond(x, y, dx, dy, 119, 96);
+    EXPECT_EQUAL(x, 120);
+    EXPECT_EQUAL(y, 97);
+    EXPECT_EQUAL(dy, -4);
+    EXPECT_EQUAL(dx, 1);
+
+    /* From the right. */
+    x = 148, y = 120, dx = -4, dy = 0;
+    wall.respond(x, y, dx, dy, 152, 120);
+    EXPECT_EQUAL(x, 152);
+    EXPECT_EQUAL(dx, 2);
+    EXPECT(!wall.contains(x, y));
+
+    /* Landing exactly on the left edge still ends up outside. */
+    x = 100, y = 120, dx = 3, dy = 0;
+    wall.respond(x, y, dx, dy, 97, 120);
+    EXPECT(x < 100);
+
+    Collider glue = { 100, 100, 50, 50, CollisionResponse::STICK, 1 };
+    x = 120, y = 103, dx = 1, dy = 8;
+    glue.respond(x, y, dx, dy, 119, 96);
+    EXPECT_EQUAL(x, 119);
+    EXPECT_EQUAL(y, 96);
+    EXPECT_EQUAL(dx, 0);
+    EXPECT_EQUAL(dy, 0);
+}
+
+STUDENT_TEST("collider set finds rectangles a move passes through") {
+    ColliderSet colliders;
+    colliders.add({ 100, 100, 200, 2, CollisionResponse::BOUNCE, 1 });
+    colliders.add({ 100, 150, 200, 2, CollisionResponse::ABSORB, 1 });
+
+    /* Ends up past both; the first one on the way is the one hit. */
+    EXPECT_EQUAL(colliders.find(150, 160), -1);
+    EXPECT_EQUAL(colliders.findHit(150, 90, 150, 160), 0);
+    EXPECT_EQUAL(colliders.findHit(150, 160, 150, 90), 1);
+    EXPECT_EQUAL(colliders.findHit(150, 110, 150, 140), -1);
+    EXPECT_EQUAL(colliders.findHit(50, 90, 90, 160), -1);
+
+    /* Diagonally across a corner. */
+    EXPECT_EQUAL(colliders.findHit(95, 99, 105, 103), 0);
+    EXPECT_EQUAL(colliders.findHit(95, 99, 101, 93), -1);
+
+    /* Bouncing off the side it came in through, from all the way past it. */
+    const Collider& floor = colliders[0];
+    double x = 150, y = 160, dx = 0, dy = 70;
+    floor.respond(x, y, dx, dy, 150, 90);
+    EXPECT_EQUAL(y, 40);
+    EXPECT_EQUAL(dy, -70);
+}
+
+STUDENT_TEST("collider set lays its grid over the bounds") {
+    ColliderSet colliders;
+    colliders.setBounds(ParticleBounds::rectangle(-5000, 1000, 10000, 64));
+    colliders.add({ -4000, 1010, 10, 10, CollisionResponse::ABSORB, 1 });
+    colliders.add({ 4000, 1010, 10, 10, CollisionResponse::ABSORB, 1 });
+    EXPECT_EQUAL(colliders._numCols, ColliderSet::kMaxCellsPerSide);
+    EXPECT_EQUAL(colliders._numRows, 2);
+    EXPECT_EQUAL(colliders.find(-3995, 1015), 0);
+    EXPECT_EQUAL(colliders.find(4005, 1015), 1);
+    EXPECT_EQUAL(colliders.find(0, 1015), -1);
+
+    /* The two rectangles are far enough apart not to share a cell. */
+    EXPECT_EQUAL(colliders._cells[colliders.colOf(-3995)].size(), 1);
+
+    /* Open sides stop at the farthest rectangles. */
+    colliders.setBounds(ParticleBounds::unbounded());
+    EXPECT_EQUAL(colliders._minX, -4000);
+    EXPECT_EQUAL(colliders._minY, 1010);
+    EXPECT_EQUAL(colliders.find(4005, 1015), 1);
+}
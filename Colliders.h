@@ -0,0 +1,112 @@
+/******************************************************************************
+ * File: Colliders.h
+ *
+ * Solid rectangles that particles run into, such as the parts of a scene
+ * that are drawn with fillRect. Each rectangle says what happens to a
+ * particle that moves into it:
+ *
+ *   CollisionResponse::BOUNCE: The particle is reflected off the side it
+ *                              came in through, keeping some fraction of
+ *                              its speed.
+ *   CollisionResponse::ABSORB: The particle is removed.
+ *   CollisionResponse::STICK:  The particle goes back to where it was before
+ *                              the move and stops.
+ *
+ * Particles are checked along the whole of each move, not just where they
+ * end up, so a fast particle can't jump over a thin rectangle.
+ *
+ * Rectangles are filed in a grid of cells over the particle system's
+ * bounds, so finding the ones a move runs into only means looking at the
+ * few that overlap the cells the move passes over, not at all of them.
+ */
+#pragma once
+
+#include "ParticleBounds.h"
+#include "GUI/SimpleTest.h"
+#include <vector>
+
+enum class CollisionResponse {
+    BOUNCE, ABSORB, STICK
+};
+
+/* The rectangle [x, x + width) x [y, y + height). */
+struct Collider {
+    double x, y, width, height;
+    CollisionResponse response;
+
+    /* Fraction of its speed a bouncing particle keeps. */
+    double bounciness;
+
+    bool contains(double px, double py) const;
+
+    /* Returns how far along the move from (prevX, prevY) to (px, py) the
+     * particle reaches the rectangle, from 0 at the start to 1 at the end,
+     * or -1 if the move never touches it.
+     */
+    double hitTime(double prevX, double prevY, double px, double py) const;
+
+    /* Applies a BOUNCE or STICK response to a particle that has just moved
+     * from (prevX, prevY) to (x, y), running into the rectangle on the
+     * way. A bouncing particle is reflected off the side it came in
+     * through, even if the move took it out the other side. A particle
+     * that was already inside the rectangle before the move is left alone.
+     */
+    void respond(double& x, double& y, double& dx, double& dy, double prevX, double prevY) const;
+};
+
+class ColliderSet {
+public:
+    /* Width of the grid cells, unless the bounds are so large that this
+     * would make more than kMaxCellsPerSide cells across or down.
+     */
+    static constexpr double kCellSize = 32;
+    static constexpr int kMaxCellsPerSide = 256;
+
+    /* Lays the grid over the given bounds, the same ones the particle
+     * system uses. An open side of the bounds stops at the farthest
+     * rectangle instead. The default is the scene.
+     */
+    void setBounds(const ParticleBounds& bounds);
+
+    /* Adds a rectangle. */
+    void add(const Collider& collider);
+
+    /* Removes every rectangle. */
+    void clear();
+
+    int size() const;
+    bool isEmpty() const;
+    const Collider& operator[](int index) const;
+
+    /* Returns the index of a rectangle containing (x, y), or -1 if there
+     * isn't one. If several rectangles contain the point, the one added
+     * first is returned.
+     */
+    int find(double x, double y) const;
+
+    /* Returns the index of the rectangle a particle moving from
+     * (prevX, prevY) to (x, y) runs into first, or -1 if it misses them
+     * all. Ties go to the rectangle added first.
+     */
+    int findHit(double prevX, double prevY, double x, double y) const;
+
+private:
+    std::vector<Collider> _colliders;
+    ParticleBounds _bounds;
+
+    /* The rectangles overlapping each cell, in the order they were added.
+     * The grid covers _minX, _minY onward; points and rectangles outside
+     * it use the nearest cells.
+     */
+    std::vector<std::vector<int>> _cells;
+    double _minX = 0, _minY = 0;
+    double _cellWidth = kCellSize, _cellHeight = kCellSize;
+    int _numCols = 1, _numRows = 1;
+
+    void rebuild();
+    int colOf(double x) const;
+    int rowOf(double y) const;
+
+    /* Allows SimpleTest to peek inside the ColliderSet type. */
+    ALLOW_TEST_ACCESS();
+};
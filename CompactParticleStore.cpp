@@ -0,0 +1,62 @@
+/*
+ * Tests for the compact particle store. The store itself is ParticleArrays
+ * with smaller field types, so it all lives in the headers.
+ */
+#include "CompactParticleStore.h"
+#include "GUI/SimpleTest.h"
+#include <climits>
+using namespace std;
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("compact store gives back the particles it was given") {
+    CompactParticleStore store;
+
+    Particle particle;
+    particle.x = 123.5;
+    particle.y = 0.25;
+    particle.dx = -3;
+    particle.dy = 7.75;
+    particle.lifetime = 1000;
+    particle.type = ParticleType::FIREWORK;
+    particle.color = Color(12, 200, 255);
+    store.push(particle);
+
+    /* Everything here is exact in a float. */
+    EXPECT_EQUAL(store.get(0), particle);
+
+    /* Colors survive packing. */
+    for (Color color: { Color(0, 0, 0), Color(255, 255, 255), Color(1, 128, 254) }) {
+        EXPECT_EQUAL(Color(PackedColor(color)), color);
+    }
+    EXPECT_EQUAL(PackedColor(Color(0x12, 0x34, 0x56)).rgba, 0x123456FFu);
+
+    /* Lifetimes too long for 16 bits are cut down, not wrapped around. */
+    particle.lifetime = INT_MAX;
+    store.push(particle);
+    EXPECT_EQUAL(store.lifetime[1], INT16_MAX);
+    EXPECT_EQUAL(store.get(1).lifetime, INT16_MAX);
+}
+
+STUDENT_TEST("compact store drops invalid particles from a batch") {
+    CompactParticleStore store;
+    int i = 0;
+    int first = store.emit(40, [&](Particle& particle) {
+        particle.x = i % 4 == 0 ? -1 : 10 * i;
+        particle.y = 100;
+        particle.lifetime = i % 5 == 0 ? -1 : 10;
+        i++;
+    });
+    EXPECT_EQUAL(first, 0);
+    EXPECT_EQUAL(store.size(), 40);
+
+    store.removeInvalid(0, ParticleBounds());
+    EXPECT_EQUAL(store.size(), 40 - 10 - 8 + 2);
+    for (int i = 0; i < store.size(); i++) {
+        EXPECT(store.x[i] >= 0);
+        EXPECT(store.lifetime[i] >= 0);
+    }
+
+    /* Four floats, a 16-bit lifetime, a one-byte type and a packed color. */
+    EXPECT_EQUAL(store.bytesReserved(), store.capacity() * 23LL);
+}
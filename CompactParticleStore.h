@@ -0,0 +1,41 @@
+/******************************************************************************
+ * File: CompactParticleStore.h
+ *
+ * A smaller version of ParticleStore (see ParticleStore.h), built from the
+ * same ParticleArrays. Positions and velocities are floats rather than
+ * doubles, lifetimes are 16 bits, and colors are packed into a single
+ * 32-bit RGBA word, which brings the fields the update loop touches from 36
+ * bytes per particle down to 18. Scenes are at most a few thousand pixels
+ * across, where a float still resolves well under a hundredth of a pixel,
+ * so the loss in precision doesn't show. Lifetimes longer than 32767 ticks,
+ * about eleven minutes at 50 ticks a second, are cut down to that.
+ *
+ * Particles go in and come out as ordinary Particles, so code using the
+ * store only sees the smaller types if it reads the arrays directly.
+ */
+#pragma once
+
+#include "Particle.h"
+#include "ParticleStore.h"
+#include <cstdint>
+#include <vector>
+
+/* A color packed into one 32-bit word as 0xRRGGBBAA. Alpha is always
+ * opaque, since Color doesn't have any.
+ */
+struct PackedColor {
+    uint32_t rgba = 0x000000FF;
+
+    PackedColor() = default;
+    PackedColor(const Color& color) {
+        rgba = uint32_t(color.red()) << 24 | uint32_t(color.green()) << 16 |
+               uint32_t(color.blue()) << 8 | 0xFF;
+    }
+
+    operator Color() const {
+        return Color(rgba >> 24, (rgba >> 16) & 0xFF, (rgba >> 8) & 0xFF);
+    }
+};
+
+/* A particle store with the smaller fields described above. */
+struct CompactParticleStore: ParticleArrays<CompactParticleStore, float, int16_t, PackedColor> {};
@@ -2,9 +2,22 @@
 
 #include "Demos/Color.h"
 
+struct PackedColor; // See CompactParticleStore.h
+
 /* Draws a particle on the screen at the given (x, y) coordinate. */
 void drawParticle(double x, double y, Color color);
 
+/* Draws 'count' particles at once. Particle i is at (xs[i], ys[i]) and has
+ * color colors[i]. If a batch draw function has been installed it gets the
+ * whole batch in one call; otherwise each particle goes to drawParticle.
+ */
+void drawParticleBatch(const double* xs, const double* ys, const Color* colors, int count);
+
+/* The same, for particles kept in a CompactParticleStore. The batch is
+ * converted to doubles and Colors before being drawn.
+ */
+void drawParticleBatch(const float* xs, const float* ys, const PackedColor* colors, int count);
+
 
 
 
@@ -17,3 +30,15 @@ void drawParticle(double x, double y, Color color);
 
 using DrawFunction = std::function<void (double x, double y, Color color)>;
 void setDrawFunction(DrawFunction fn);
+
+/* Renderers that can draw many particles in one go can install a batch draw
+ * function. Passing nullptr goes back to drawing one particle at a time.
+ */
+using BatchDrawFunction = std::function<void (const double* xs, const double* ys,
+                                              const Color* colors, int count)>;
+void setBatchDrawFunction(BatchDrawFunction fn);
+
+/* The batch draw function installed now, or nullptr if there isn't one, so
+ * that it can be put back after being replaced for a while.
+ */
+BatchDrawFunction batchDrawFunction();
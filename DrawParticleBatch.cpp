@@ -0,0 +1,46 @@
+/*
+ * Batch drawing for particles. Without a batch draw function installed, a
+ * batch is just drawn one particle at a time with drawParticle, which keeps
+ * anything hooked up through setDrawFunction (like ParticleCatcher) working.
+ */
+#include "DrawParticle.h"
+#include "CompactParticleStore.h"
+#include <vector>
+using namespace std;
+
+namespace {
+    /* The installed batch draw function, if any. */
+    BatchDrawFunction& installedBatchDraw() {
+        static BatchDrawFunction fn;
+        return fn;
+    }
+}
+
+void setBatchDrawFunction(BatchDrawFunction fn) {
+    installedBatchDraw() = fn;
+}
+
+BatchDrawFunction batchDrawFunction() {
+    return installedBatchDraw();
+}
+
+void drawParticleBatch(const double* xs, const double* ys, const Color* colors, int count) {
+    if (installedBatchDraw()) {
+        installedBatchDraw()(xs, ys, colors, count);
+    }
+    else {
+        for (int i = 0; i < count; i++) {
+            drawParticle(xs[i], ys[i], colors[i]);
+        }
+    }
+}
+
+void drawParticleBatch(const float* xs, const float* ys, const PackedColor* colors, int count) {
+    /* Reused between calls so that drawing doesn't allocate. */
+    static vector<double> wideX, wideY;
+    static vector<Color> wideColors;
+    wideX.assign(xs, xs + count);
+    wideY.assign(ys, ys + count);
+    wideColors.assign(colors, colors + count);
+    drawParticleBatch(wideX.data(), wideY.data(), wideColors.data(), count);
+}
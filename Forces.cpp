@@ -0,0 +1,223 @@
+#include "Forces.h"
+#include "ParticleKernels.h"
+#include "GUI/SimpleTest.h"
+#include "error.h"
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+Force Force::constant(double ax, double ay) {
+    Force result;
+    result.kind = Kind::CONSTANT;
+    result.x = ax;
+    result.y = ay;
+    return result;
+}
+
+Force Force::drag(double fraction) {
+    Force result;
+    result.kind = Kind::DRAG;
+    result.x = fraction;
+    return result;
+}
+
+Force Force::attractor(double x, double y, double strength, double minDistance) {
+    /* A particle right at the center would otherwise be pushed by 0 / 0. */
+    if (!isfinite(minDistance) || minDistance <= 0) {
+        error("An attractor or vortex needs a finite minimum distance greater than zero");
+    }
+    if (!isfinite(x) || !isfinite(y) || !isfinite(strength)) {
+        error("An attractor or vortex needs a finite center and strength");
+    }
+
+    Force result;
+    result.kind = Kind::ATTRACTOR;
+    result.x = x;
+    result.y = y;
+    result.strength = strength;
+    result.minDistance = minDistance;
+    return result;
+}
+
+Force Force::vortex(double x, double y, double strength, double minDistance) {
+    Force result = attractor(x, y, strength, minDistance);
+    result.kind = Kind::VORTEX;
+    return result;
+}
+
+Force Force::custom(ForceFunction fn) {
+    Force result;
+    result.kind = Kind::CUSTOM;
+    result.fn = fn;
+    return result;
+}
+
+Force Force::only(ParticleType type) const {
+    Force result = *this;
+    result.types = 1u << int(type);
+    return result;
+}
+
+bool Force::affects(ParticleType type) const {
+    return types & (1u << int(type));
+}
+
+void ForcePipeline::add(const Force& force) {
+    if (force.kind != Force::Kind::CONSTANT) {
+        _fields.push_back(force);
+        return;
+    }
+
+    for (int type = 0; type < kNumTypes; type++) {
+        if (force.affects(ParticleType(type))) {
+            _constantX[type] += force.x;
+            _constantY[type] += force.y;
+        }
+    }
+    _hasConstant = true;
+}
+
+void ForcePipeline::clear() {
+    *this = ForcePipeline();
+}
+
+bool ForcePipeline::isEmpty() const {
+    return !_hasConstant && _fields.empty();
+}
+
+namespace {
+    /* Each of these runs over all the particles with no branches in the loop,
+     * so the compiler can vectorize it.
+     */
+    void applyDrag(double* dx, double* dy, int count, double fraction) {
+        double keep = 1 - fraction;
+        for (int i = 0; i < count; i++) {
+            dx[i] *= keep;
+            dy[i] *= keep;
+        }
+    }
+
+    void applyAttractor(const Force& force, const double* x, const double* y, double* dx, double* dy,
+                        int count) {
+        double minDistanceSquared = force.minDistance * force.minDistance;
+        for (int i = 0; i < count; i++) {
+            double towardX = force.x - x[i];
+            double towardY = force.y - y[i];
+            double distanceSquared = max(towardX * towardX + towardY * towardY, minDistanceSquared);
+
+            /* strength / distance^2, along the unit vector toward the center. */
+            double scale = force.strength / (distanceSquared * sqrt(distanceSquared));
+            dx[i] += scale * towardX;
+            dy[i] += scale * towardY;
+        }
+    }
+
+    void applyVortex(const Force& force, const double* x, const double* y, double* dx, double* dy,
+                     int count) {
+        double minDistanceSquared = force.minDistance * force.minDistance;
+        for (int i = 0; i < count; i++) {
+            double awayX = x[i] - force.x;
+            double awayY = y[i] - force.y;
+            double distanceSquared = max(awayX * awayX + awayY * awayY, minDistanceSquared);
+
+            /* strength / distance, at right angles to the center. */
+            double scale = force.strength / distanceSquared;
+            dx[i] -= scale * awayY;
+            dy[i] += scale * awayX;
+        }
+    }
+}
+
+void ForcePipeline::apply(ParticleType type, const double* x, const double* y, double* dx, double* dy,
+                          int count) const {
+    for (const Force& force: _fields) {
+        if (!force.affects(type)) continue;
+
+        switch (force.kind) {
+        case Force::Kind::DRAG:
+            applyDrag(dx, dy, count, force.x);
+            break;
+        case Force::Kind::ATTRACTOR:
+            applyAttractor(force, x, y, dx, dy, count);
+            break;
+        case Force::Kind::VORTEX:
+            applyVortex(force, x, y, dx, dy, count);
+            break;
+        case Force::Kind::CUSTOM:
+            force.fn(x, y, dx, dy, count);
+            break;
+        case Force::Kind::CONSTANT:
+            break; // Folded into _constantX and _constantY
+        }
+    }
+
+    if (_hasConstant) {
+        addToVelocities(dx, dy, count, _constantX[int(type)], _constantY[int(type)]);
+    }
+}
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("force pipeline folds constant forces and applies the rest in order") {
+    ForcePipeline pipeline;
+    EXPECT(pipeline.isEmpty());
+
+    pipeline.add(Force::constant(1, 0));
+    pipeline.add(Force::constant(0.5, -2));
+    pipeline.add(Force::constant(0, 10).only(ParticleType::FIREWORK));
+    pipeline.add(Force::drag(0.5));
+    EXPECT(!pipeline.isEmpty());
+
+    double x[2] = { 0, 0 }, y[2] = { 0, 0 };
+    double dx[2] = { 4, -2 }, dy[2] = { 0, 6 };
+    pipeline.apply(ParticleType::STREAMER, x, y, dx, dy, 2);
+    EXPECT_EQUAL(dx[0], 2 + 1.5);
+    EXPECT_EQUAL(dx[1], -1 + 1.5);
+    EXPECT_EQUAL(dy[0], 0 - 2);
+    EXPECT_EQUAL(dy[1], 3 - 2);
+
+    pipeline.clear();
+    EXPECT(pipeline.isEmpty());
+
+    /* An attractor pulls with strength / distance^2, and a vortex swirls at
+     * right angles to the center.
+     */
+    pipeline.add(Force::attractor(10, 0, 200));
+    pipeline.add(Force::vortex(0, 0, 5).only(ParticleType::BALLISTIC));
+    double px[1] = { 0 }, py[1] = { 0 };
+    double pdx[1] = { 0 }, pdy[1] = { 0 };
+    pipeline.apply(ParticleType::STREAMER, px, py, pdx, pdy, 1);
+    EXPECT_EQUAL(pdx[0], 2);
+    EXPECT_EQUAL(pdy[0], 0);
+
+    px[0] = 10;
+    pdx[0] = 0;
+    pipeline.apply(ParticleType::BALLISTIC, px, py, pdx, pdy, 1);
+    EXPECT_EQUAL(pdx[0], 0);  // At the attractor, which pulls nowhere
+    EXPECT_EQUAL(pdy[0], 0.5);
+}
+
+STUDENT_TEST("attractors and vortices need a positive, finite minimum distance") {
+    for (double minDistance: { 0.0, -5.0, double(NAN), double(INFINITY) }) {
+        EXPECT_ERROR(Force::attractor(0, 0, 1, minDistance));
+        EXPECT_ERROR(Force::vortex(0, 0, 1, minDistance));
+    }
+    EXPECT_ERROR(Force::attractor(NAN, 0, 1));
+    EXPECT_ERROR(Force::vortex(0, 0, INFINITY));
+
+    /* A particle right at the center isn't pushed at all. */
+    ForcePipeline pipeline;
+    pipeline.add(Force::attractor(5, 5, 100, 1e-3));
+    pipeline.add(Force::vortex(5, 5, 100, 1e-3));
+    double x[1] = { 5 }, y[1] = { 5 }, dx[1] = { 0 }, dy[1] = { 0 };
+    pipeline.apply(ParticleType::STREAMER, x, y, dx, dy, 1);
+    EXPECT_EQUAL(dx[0], 0);
+    EXPECT_EQUAL(dy[0], 0);
+
+    /* A default force does nothing. */
+    pipeline.clear();
+    pipeline.add(Force());
+    dx[0] = 2;
+    pipeline.apply(ParticleType::STREAMER, x, y, dx, dy, 1);
+    EXPECT_EQUAL(dx[0], 2);
+}
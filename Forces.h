@@ -0,0 +1,101 @@
+/******************************************************************************
+ * File: Forces.h
+ *
+ * Forces that change particles' velocities on every move, on top of the
+ * built-in gravity on ballistic particles and fireworks. Each force is one
+ * of:
+ *
+ *   Force::constant(ax, ay):  The same push for every particle, like wind.
+ *   Force::drag(fraction):    Takes away a fraction of every velocity.
+ *   Force::attractor(x, y, strength):
+ *                             Pulls particles toward (x, y), falling off
+ *                             with the square of the distance. A negative
+ *                             strength pushes them away.
+ *   Force::vortex(x, y, strength):
+ *                             Swirls particles around (x, y), clockwise on
+ *                             screen for a positive strength, falling off
+ *                             with distance.
+ *   Force::custom(fn):        Anything else; see ForceFunction.
+ *
+ * Any force can be limited to one type of particle with only(type).
+ * attractor and vortex report an error unless minDistance (see below) is
+ * positive and the center, strength and minDistance are all finite.
+ *
+ * A ForcePipeline runs a list of forces over whole arrays of particles at
+ * once. Constant forces are added together when they're added to the
+ * pipeline, so however many there are, they cost one add per particle.
+ */
+#pragma once
+
+#include "Particle.h"
+#include <functional>
+#include <vector>
+
+/* Changes the velocities (dx[i], dy[i]) of 'count' particles at positions
+ * (x[i], y[i]). Called from several threads at once if the particle system
+ * uses more than one.
+ */
+using ForceFunction = std::function<void (const double* x, const double* y, double* dx, double* dy,
+                                          int count)>;
+
+struct Force {
+    static Force constant(double ax, double ay);
+    static Force drag(double fraction);
+    static Force attractor(double x, double y, double strength, double minDistance = 10);
+    static Force vortex(double x, double y, double strength, double minDistance = 10);
+    static Force custom(ForceFunction fn);
+
+    /* The same force, acting only on particles of the given type. */
+    Force only(ParticleType type) const;
+
+    enum class Kind {
+        CONSTANT, DRAG, ATTRACTOR, VORTEX, CUSTOM
+    };
+    Kind kind = Kind::CONSTANT;
+
+    /* Meaning depends on the kind: the push for CONSTANT, the center for
+     * ATTRACTOR and VORTEX, and x is the fraction for DRAG.
+     */
+    double x = 0, y = 0;
+    double strength = 0;
+
+    /* ATTRACTOR and VORTEX treat particles closer than this as being this
+     * far away, so particles near the center aren't flung off.
+     */
+    double minDistance = 0;
+
+    ForceFunction fn;
+
+    /* Which particle types feel the force, one bit per type. */
+    unsigned types = 0b111;
+
+    bool affects(ParticleType type) const;
+};
+
+class ForcePipeline {
+public:
+    /* Adds a force to the pipeline. */
+    void add(const Force& force);
+
+    /* Removes every force. */
+    void clear();
+
+    bool isEmpty() const;
+
+    /* Applies the forces, in the order they were added, to 'count'
+     * particles of the given type. The constant forces, all added
+     * together, go last.
+     */
+    void apply(ParticleType type, const double* x, const double* y, double* dx, double* dy,
+               int count) const;
+
+private:
+    static const int kNumTypes = 3;
+
+    /* The sum of the constant forces on each type. */
+    double _constantX[kNumTypes] = {}, _constantY[kNumTypes] = {};
+    bool _hasConstant = false;
+
+    /* Every other force. */
+    std::vector<Force> _fields;
+};
@@ -13,8 +13,10 @@
  *   ParticleType::FIREWORK:  Like a ballistic particle, but when its lifetime
  *                            ends, a firework explodes into a bunch of
  *                            streamers.
+ *
+ * Types are stored in a single byte, so arrays of them stay small.
  */
-enum class ParticleType {
+enum class ParticleType: unsigned char {
     STREAMER, BALLISTIC, FIREWORK
 };
 
@@ -0,0 +1,133 @@
+/******************************************************************************
+ * File: ParticleBehaviors.h
+ *
+ * Behaviors that can be plugged into a BasicParticleSystem (see
+ * BasicParticleSystem.h). Each behavior is a type with static hooks that the
+ * system calls while moving particles. The hooks are templates over the
+ * kind of store, so the same behaviors work with a ParticleStore or a
+ * CompactParticleStore. Every hook has a do-nothing version in
+ * ParticleBehavior, so a behavior only needs to define the hooks it cares
+ * about. Since the behaviors are template arguments, the compiler can inline
+ * all of them into a single loop, and behaviors a system doesn't list cost
+ * nothing at all.
+ */
+#pragma once
+
+#include "ParticleBounds.h"
+#include "ParticleRandom.h"
+#include "Particle.h"
+#include <cmath>
+
+/* Base type for all behaviors. Every hook does nothing. */
+struct ParticleBehavior {
+    /* Called once per tick for each particle, after it has moved by its
+     * velocity and lost one unit of lifetime.
+     */
+    template <typename Store> static void update(Store&, int) {}
+
+    /* Returns whether the particle should be removed because of where it
+     * is. 'bounds' is the region the system keeps its particles in.
+     */
+    template <typename Store> static bool outOfBounds(const Store&, int, const ParticleBounds&) {
+        return false;
+    }
+
+    /* Called for each particle whose lifetime has run out, just before it's
+     * removed. New particles go into 'spawned'; they're added to the system
+     * once the tick is over. Random numbers should come from the system's
+     * generator, 'random', so that seeding the system makes runs repeatable.
+     */
+    template <typename Store> static void expire(const Store&, int, Store&, ParticleRandom&) {}
+};
+
+/* Accelerates every particle downward by kAcceleration per tick. This is
+ * the dy++ step ballistic particles and fireworks take in ParticleSystem.
+ */
+template <int kAcceleration> struct Gravity: ParticleBehavior {
+    template <typename Store> static void update(Store& store, int index) {
+        store.dy[index] += kAcceleration;
+    }
+};
+
+/* Slows every particle down by multiplying its velocity by
+ * kNumerator / kDenominator each tick.
+ */
+template <int kNumerator, int kDenominator> struct Drag: ParticleBehavior {
+    template <typename Store> static void update(Store& store, int index) {
+        const double kFactor = double(kNumerator) / kDenominator;
+        store.dx[index] *= kFactor;
+        store.dy[index] *= kFactor;
+    }
+};
+
+/* Removes particles that leave the system's bounds, the same as
+ * ParticleSystem does.
+ */
+struct CullOutOfBounds: ParticleBehavior {
+    template <typename Store>
+    static bool outOfBounds(const Store& store, int index, const ParticleBounds& bounds) {
+        return !bounds.contains(store.x[index], store.y[index]);
+    }
+};
+
+/* Particles that leave one side of the scene come back in the other. This
+ * always wraps around the whole scene, whatever the system's bounds.
+ */
+struct WrapAround: ParticleBehavior {
+    template <typename Store> static void update(Store& store, int index) {
+        store.x[index] = wrap(store.x[index], SCENE_WIDTH);
+        store.y[index] = wrap(store.y[index], SCENE_HEIGHT);
+    }
+
+    static double wrap(double value, double size) {
+        if (value >= 0 && value < size) {
+            return value;
+        }
+        double result = std::fmod(value, size);
+        return result < 0 ? result + size : result;
+    }
+};
+
+/* When a firework's lifetime runs out, it bursts into kNumChildren streamers
+ * of one random color. Each streamer gets a whole-number velocity between
+ * kMinSpeed and kMaxSpeed on each axis and a lifetime between kMinLifetime
+ * and kMaxLifetime. Particles that aren't fireworks just expire.
+ */
+template <int kNumChildren, int kMinSpeed, int kMaxSpeed, int kMinLifetime, int kMaxLifetime>
+struct ExplodeOnExpire: ParticleBehavior {
+    template <typename Store>
+    static void expire(const Store& store, int index, Store& spawned, ParticleRandom& random) {
+        if (store.type[index] != ParticleType::FIREWORK) return;
+
+        burst(store.x[index], store.y[index], random, [&](const Particle& child) {
+            spawned.push(child);
+        });
+    }
+
+    /* Makes the streamers for a firework that bursts at (x, y), calling
+     * emit(child) for each one. Systems that don't keep their streamers in
+     * a store, like ParticleSystem, use this directly.
+     */
+    template <typename Emit> static void burst(double x, double y, ParticleRandom& random, Emit emit) {
+        int speeds[2 * kNumChildren];
+        int lifetimes[kNumChildren];
+        Color color = random.color();
+        random.integers(speeds, 2 * kNumChildren, kMinSpeed, kMaxSpeed);
+        random.integers(lifetimes, kNumChildren, kMinLifetime, kMaxLifetime);
+
+        for (int i = 0; i < kNumChildren; i++) {
+            Particle child;
+            child.color = color;
+            child.x = x;
+            child.y = y;
+            child.dx = speeds[2 * i];
+            child.dy = speeds[2 * i + 1];
+            child.lifetime = lifetimes[i];
+            child.type = ParticleType::STREAMER;
+            emit(child);
+        }
+    }
+};
+
+/* The explosion ParticleSystem uses for its fireworks. */
+using FireworkExplosion = ExplodeOnExpire<50, -3, 3, 2, 10>;
@@ -0,0 +1,111 @@
+/******************************************************************************
+ * File: ParticleBenchmarkMain.cpp
+ *
+ * A command-line program that runs the particle benchmarks (see
+ * ParticleBenchmarks.h) with no window and writes the results as JSON.
+ *
+ * The rest of the project is a graphical program with its own main, so this
+ * one is only compiled when building with PARTICLE_BENCHMARK_MAIN defined
+ * (for example, with -DPARTICLE_BENCHMARK_MAIN), as its own program made of
+ * the same sources. Usage:
+ *
+ *     particle-benchmarks [--sizes 10000,100000] [--frames 20]
+ *                         [--threads 1] [--seed 106] [--output results.json]
+ *
+ * Any option left out keeps its value from BenchmarkOptions. Without
+ * --output, the results go to standard output.
+ */
+#ifdef PARTICLE_BENCHMARK_MAIN
+
+#include "ParticleBenchmarks.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+using namespace std;
+
+namespace {
+    void usage(const string& program) {
+        cerr << "Usage: " << program << " [--sizes N,N,...] [--frames N] [--threads N]"
+             << " [--seed N] [--output FILE]" << endl;
+    }
+
+    /* Reads a list of particle counts such as "10000,100000". Returns
+     * whether it was all counts.
+     */
+    bool readSizes(const string& text, vector<int>& sizes) {
+        sizes.clear();
+        istringstream in(text);
+        string item;
+        while (getline(in, item, ',')) {
+            istringstream number(item);
+            int size;
+            if (!(number >> size) || !number.eof() || size < 0) return false;
+            sizes.push_back(size);
+        }
+        return !sizes.empty();
+    }
+
+    /* Reads one whole number of at least 'least'. */
+    template <typename Number> bool readNumber(const string& text, Number least, Number& result) {
+        istringstream in(text);
+        return in >> result && in.eof() && result >= least;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    string outputFile;
+
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if (i + 1 == argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        string value = argv[++i];
+
+        bool ok;
+        if (option == "--sizes") {
+            ok = readSizes(value, options.sizes);
+        }
+        else if (option == "--frames") {
+            ok = readNumber(value, 1, options.numFrames);
+        }
+        else if (option == "--threads") {
+            ok = readNumber(value, 1, options.numThreads);
+        }
+        else if (option == "--seed") {
+            ok = readNumber<uint64_t>(value, 0, options.seed);
+        }
+        else if (option == "--output") {
+            outputFile = value;
+            ok = true;
+        }
+        else {
+            ok = false;
+        }
+
+        if (!ok) {
+            cerr << "Bad option: " << option << " " << value << endl;
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    vector<BenchmarkResult> results = runParticleBenchmarks(options);
+    if (outputFile.empty()) {
+        writeBenchmarkJson(cout, options, results);
+        return 0;
+    }
+
+    ofstream out(outputFile);
+    writeBenchmarkJson(out, options, results);
+    if (!out) {
+        cerr << "Couldn't write " << outputFile << endl;
+        return 1;
+    }
+    return 0;
+}
+
+#endif
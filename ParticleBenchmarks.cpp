@@ -0,0 +1,380 @@
+/*
+ * The benchmarks. Each scene workload makes its particles with the scene's
+ * own functions (see Scenes/), so it stays in step with the scene, but makes
+ * many more particles per tick, chosen so that the number of live particles
+ * settles near the size being measured.
+ */
+#include "ParticleBenchmarks.h"
+#include "ParticleSystem.h"
+#include "BasicParticleSystem.h"
+#include "DrawParticle.h"
+#include "Scenes/Fireworks.h"
+#include "Scenes/Fountain.h"
+#include "Scenes/MagicWand.h"
+#include "Scenes/PhotoExploder.h"
+#include "Scenes/SnowyDay.h"
+#include "GUI/SimpleTest.h"
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <sstream>
+using namespace std;
+
+double BenchmarkResult::nsPerOp() const {
+    return operations == 0 ? 0 : seconds * 1e9 / operations;
+}
+
+namespace {
+    /* Runs fn() and returns how many seconds it took. */
+    template <typename Function> double secondsFor(Function fn) {
+        auto start = chrono::steady_clock::now();
+        fn();
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    /* While one of these exists, drawn particles go nowhere. The batch draw
+     * function from before is put back afterward.
+     */
+    class NullDrawing {
+    public:
+        NullDrawing(): saved(batchDrawFunction()) {
+            setBatchDrawFunction([](const double*, const double*, const Color*, int) {
+                /* Nothing to do. */
+            });
+        }
+        ~NullDrawing() {
+            setBatchDrawFunction(saved);
+        }
+
+        NullDrawing(const NullDrawing&) = delete;
+        NullDrawing& operator= (const NullDrawing&) = delete;
+
+    private:
+        BatchDrawFunction saved;
+    };
+
+    /* A particle somewhere in the scene, drifting slowly. */
+    Particle randomStreamer(ParticleRandom& random, int lifetime) {
+        Particle particle;
+        particle.x = random.real(0, SCENE_WIDTH);
+        particle.y = random.real(0, SCENE_HEIGHT);
+        particle.dx = random.real(-1, 1);
+        particle.dy = random.real(-1, 1);
+        particle.lifetime = lifetime;
+        particle.color = random.color();
+        particle.type = ParticleType::STREAMER;
+        return particle;
+    }
+
+    void benchmarkAdd(int size, const BenchmarkOptions& options, vector<BenchmarkResult>& results) {
+        ParticleRandom random(options.seed);
+        vector<Particle> particles(size);
+        for (Particle& particle: particles) {
+            particle = randomStreamer(random, 100);
+        }
+
+        ParticleSystem one;
+        double oneSeconds = secondsFor([&] {
+            for (const Particle& particle: particles) {
+                one.add(particle);
+            }
+        });
+        results.push_back({ "add", size, size, oneSeconds });
+
+        ParticleSystem batch;
+        double batchSeconds = secondsFor([&] {
+            batch.addAll(particles.data(), particles.size());
+        });
+        results.push_back({ "add_batch", size, size, batchSeconds });
+    }
+
+    void benchmarkMoveAndDraw(int size, const BenchmarkOptions& options, vector<BenchmarkResult>& results) {
+        /* Ballistic particles that never leave, so the count stays put. */
+        ParticleSystem system;
+        system.seed(options.seed);
+        system.setThreadCount(options.numThreads);
+        system.setBounds(ParticleBounds::unbounded());
+        system.emit(size, ParticleType::BALLISTIC, [&](Particle& particle) {
+            particle = randomStreamer(system.random(), INT_MAX);
+        });
+
+        long long operations = (long long) size * options.numFrames;
+        double moveSeconds = secondsFor([&] {
+            for (int frame = 0; frame < options.numFrames; frame++) {
+                system.moveParticles();
+            }
+        });
+        results.push_back({ "move", size, operations, moveSeconds });
+
+        double drawSeconds = secondsFor([&] {
+            for (int frame = 0; frame < options.numFrames; frame++) {
+                system.drawParticles();
+            }
+        });
+        results.push_back({ "draw", size, operations, drawSeconds });
+    }
+
+    void benchmarkExplode(int size, const BenchmarkOptions& options, vector<BenchmarkResult>& results) {
+        /* Each firework makes 50 streamers, so this many fireworks end up as
+         * about 'size' particles.
+         */
+        int numFireworks = max(1, size / 50);
+
+        ParticleSystem system;
+        system.seed(options.seed);
+        system.setThreadCount(options.numThreads);
+        system.emit(numFireworks, ParticleType::FIREWORK, [&](Particle& particle) {
+            particle = randomStreamer(system.random(), 0);
+        });
+
+        double seconds = secondsFor([&] {
+            system.moveParticles();
+        });
+        results.push_back({ "explode", size, numFireworks, seconds });
+    }
+
+    void benchmarkChurn(int size, const BenchmarkOptions& options, vector<BenchmarkResult>& results) {
+        /* Streamers live up to kMaxLifetime ticks, about half that on
+         * average, so adding size / (kMaxLifetime / 2) a tick keeps the
+         * count steady.
+         */
+        const int kMaxLifetime = 40;
+        int perFrame = max(1, size / (kMaxLifetime / 2));
+
+        ParticleSystem system;
+        system.seed(options.seed);
+        system.setThreadCount(options.numThreads);
+        auto makeStreamer = [&](Particle& particle) {
+            ParticleRandom& random = system.random();
+            particle = randomStreamer(random, random.integer(0, kMaxLifetime - 1));
+        };
+        system.emit(size, ParticleType::STREAMER, makeStreamer);
+
+        long long operations = 0;
+        double seconds = secondsFor([&] {
+            for (int frame = 0; frame < options.numFrames; frame++) {
+                system.emit(perFrame, ParticleType::STREAMER, makeStreamer);
+                operations += system.numParticles();
+                system.moveParticles();
+                system.drawParticles();
+            }
+        });
+        results.push_back({ "churn", size, operations, seconds });
+    }
+
+    /* Gets a system ready to be timed. */
+    void prepare(ParticleSystem& system, const BenchmarkOptions& options) {
+        system.seed(options.seed);
+        system.setThreadCount(options.numThreads);
+    }
+
+    template <typename System> void prepare(System& system, const BenchmarkOptions& options) {
+        system.seed(options.seed);
+    }
+
+    /* Works out how many ticks a particle added by emit(system, count) stays
+     * around for, counting the particles it spawns, by following a small
+     * batch in a system of its own until they're all gone.
+     */
+    template <typename System, typename Emitter>
+    double ticksPerParticle(const BenchmarkOptions& options, Emitter emit) {
+        const int kBatchSize = 1000;
+        const int kMaxTicks = 100000;
+
+        System system;
+        prepare(system, options);
+        emit(system, kBatchSize);
+        int numAdded = system.numParticles();
+
+        long long particleTicks = 0;
+        for (int tick = 0; tick < kMaxTicks && system.numParticles() > 0; tick++) {
+            particleTicks += system.numParticles();
+            system.moveParticles();
+        }
+        return max(1.0, double(particleTicks) / max(1, numAdded));
+    }
+
+    /* Replays a scene. Each tick, emit(system, count) adds about 'count'
+     * particles the way the scene would, and then the system is moved and
+     * drawn. The count is chosen, using ticksPerParticle, so that about
+     * 'size' particles are live. The system is run until it's full before
+     * the timing starts.
+     */
+    template <typename System, typename Emitter>
+    BenchmarkResult sceneWorkload(const string& name, int size, const BenchmarkOptions& options,
+                                  Emitter emit) {
+        double ticks = ticksPerParticle<System>(options, emit);
+        int perFrame = max(1, int(size / ticks));
+
+        System system;
+        prepare(system, options);
+        int warmup = 4 * ceil(ticks);
+        for (int frame = 0; frame < warmup && system.numParticles() < size; frame++) {
+            emit(system, perFrame);
+            system.moveParticles();
+        }
+
+        long long operations = 0;
+        double seconds = secondsFor([&] {
+            for (int frame = 0; frame < options.numFrames; frame++) {
+                emit(system, perFrame);
+                operations += system.numParticles();
+                system.moveParticles();
+                system.drawParticles();
+            }
+        });
+        return { "scene/" + name, size, operations, seconds };
+    }
+
+    /* Fountain: water sprayed upward from the emitters, taking turns, and
+     * falling under gravity until it leaves the scene.
+     */
+    BenchmarkResult fountain(int size, const BenchmarkOptions& options) {
+        Vector<GPoint> emitters = Fountain::emitterLocations();
+        return sceneWorkload<CompactParticleSystem<Gravity<1>, CullOutOfBounds>>(
+            "Fountain", size, options, [&](auto& system, int count) {
+                int next = 0;
+                system.emit(count, [&](Particle& data) {
+                    Fountain::makeWater(data, emitters[next % emitters.size()], system.random());
+                    next++;
+                });
+            });
+    }
+
+    /* SnowyDay: snow falling from the top of the scene and drifting
+     * sideways. The scene has one chance of a snowflake per column; here,
+     * each column gets several chances, one row of SCENE_WIDTH trials at a
+     * time.
+     */
+    BenchmarkResult snowyDay(int size, const BenchmarkOptions& options) {
+        return sceneWorkload<CompactParticleSystem<CullOutOfBounds>>(
+            "SnowyDay", size, options, [&](auto& system, int count) {
+                int numRows = ceil(count / SCENE_WIDTH);
+                double probability = min(1.0, count / (numRows * SCENE_WIDTH));
+                for (int row = 0; row < numRows; row++) {
+                    system.emitSparse(SCENE_WIDTH, probability, [&](Particle& snowflake, int x) {
+                        SnowyDay::makeSnowflake(snowflake, x, system.random());
+                    });
+                }
+            });
+    }
+
+    /* Fireworks: rockets launched from the bottom that explode near the top
+     * into streamers.
+     */
+    BenchmarkResult fireworks(int size, const BenchmarkOptions& options) {
+        return sceneWorkload<ParticleSystem>("Fireworks", size, options, [&](auto& system, int count) {
+            system.emit(count, ParticleType::FIREWORK, [&](Particle& particle) {
+                particle = Fireworks::makeRocket(system.random());
+            });
+        });
+    }
+
+    /* MagicWand: a shower of short-lived streamers from the tip of the wand,
+     * here held down in the middle of the scene.
+     */
+    BenchmarkResult magicWand(int size, const BenchmarkOptions& options) {
+        GPoint tip(SCENE_WIDTH / 2, SCENE_HEIGHT / 2);
+        return sceneWorkload<ParticleSystem>("MagicWand", size, options, [&](auto& system, int count) {
+            system.emit(count, ParticleType::STREAMER, [&](Particle& particle) {
+                MagicWand::makeSparkle(particle, tip, system.random());
+            });
+        });
+    }
+
+    /* PhotoExploder: every particle of an image added at once, then flying
+     * in a straight line to its place in the picture until its lifetime
+     * runs out. The picture here is random points in the scene's content
+     * area rather than a real image.
+     */
+    BenchmarkResult photoExploder(int size, const BenchmarkOptions& options) {
+        ParticleSystem system;
+        prepare(system, options);
+        system.setMotion(Motion::LAZY);
+
+        ParticleRandom random(options.seed);
+        GRectangle area = PhotoExploder::contentArea();
+        vector<Particle> particles(size);
+        for (Particle& particle: particles) {
+            double x = random.real(area.x, area.x + area.width);
+            double y = random.real(area.y, area.y + area.height);
+            PhotoExploder::aimParticle(particle, x, y, random.color(), random);
+        }
+        int numSteps = particles.empty() ? 0 : particles[0].lifetime;
+
+        long long operations = 0;
+        double seconds = secondsFor([&] {
+            system.addAll(particles.data(), particles.size());
+            for (int step = 0; step < numSteps; step++) {
+                operations += system.numParticles();
+                system.moveParticles();
+                system.drawParticles();
+            }
+        });
+        return { "scene/PhotoExploder", size, operations, seconds };
+    }
+}
+
+vector<BenchmarkResult> runParticleBenchmarks(const BenchmarkOptions& options) {
+    NullDrawing nullDrawing;
+
+    vector<BenchmarkResult> results;
+    for (int size: options.sizes) {
+        benchmarkAdd(size, options, results);
+        benchmarkMoveAndDraw(size, options, results);
+        benchmarkExplode(size, options, results);
+        benchmarkChurn(size, options, results);
+
+        results.push_back(fountain(size, options));
+        results.push_back(snowyDay(size, options));
+        results.push_back(fireworks(size, options));
+        results.push_back(magicWand(size, options));
+        results.push_back(photoExploder(size, options));
+    }
+    return results;
+}
+
+void writeBenchmarkJson(ostream& out, const BenchmarkOptions& options,
+                        const vector<BenchmarkResult>& results) {
+    out << "{\n";
+    out << "  \"frames\": " << options.numFrames << ",\n";
+    out << "  \"threads\": " << options.numThreads << ",\n";
+    out << "  \"seed\": " << options.seed << ",\n";
+    out << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    { \"benchmark\": \"" << result.benchmark << "\""
+            << ", \"particles\": "  << result.particles
+            << ", \"operations\": " << result.operations
+            << ", \"seconds\": "    << result.seconds
+            << ", \"ns_per_op\": "  << result.nsPerOp() << " }";
+    }
+    out << "\n  ]\n";
+    out << "}\n";
+}
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("benchmarks run every workload and write one JSON entry for each") {
+    BenchmarkOptions options;
+    options.sizes = { 2000 };
+    options.numFrames = 2;
+
+    vector<BenchmarkResult> results = runParticleBenchmarks(options);
+    EXPECT_EQUAL(int(results.size()), 11);
+    for (const BenchmarkResult& result: results) {
+        EXPECT_EQUAL(result.particles, 2000);
+        EXPECT(result.operations > 0);
+        EXPECT(result.seconds >= 0);
+    }
+
+    ostringstream out;
+    writeBenchmarkJson(out, options, results);
+    string json = out.str();
+    for (string name: { "add", "add_batch", "move", "draw", "explode", "churn",
+                        "scene/Fountain", "scene/SnowyDay", "scene/Fireworks",
+                        "scene/MagicWand", "scene/PhotoExploder" }) {
+        EXPECT(json.find("\"benchmark\": \"" + name + "\"") != string::npos);
+    }
+}
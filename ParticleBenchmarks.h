@@ -0,0 +1,73 @@
+/******************************************************************************
+ * File: ParticleBenchmarks.h
+ *
+ * Timing for the particle systems, for tracking performance from one change
+ * to the next. There are two kinds of benchmark:
+ *
+ *   - Microbenchmarks time one operation on a ParticleSystem: adding
+ *     particles, moving them, drawing them, exploding fireworks, and a
+ *     steady churn of particles being born and dying.
+ *   - Scene workloads replay the particle traffic of each scene (Fountain,
+ *     SnowyDay, Fireworks, MagicWand and PhotoExploder) with no window,
+ *     scaled up so that about the requested number of particles are live.
+ *
+ * Drawing goes to a batch draw function that throws the particles away, so
+ * the times measure the particle system and not the screen.
+ *
+ * Results can be written out as JSON, one object per benchmark and size:
+ *
+ *     { "benchmark": "move", "particles": 100000, "operations": 2000000,
+ *       "seconds": 0.0123, "ns_per_op": 6.15 }
+ *
+ * What an operation is depends on the benchmark; see runParticleBenchmarks.
+ * ParticleBenchmarkMain.cpp has a command-line program that runs them.
+ */
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BenchmarkOptions {
+    /* Particle counts to run every benchmark at. */
+    std::vector<int> sizes = { 10'000, 100'000, 1'000'000, 10'000'000 };
+
+    /* Number of ticks to time for benchmarks that run over several ticks. */
+    int numFrames = 20;
+
+    /* Threads for the ParticleSystem benchmarks (see setThreadCount). */
+    int numThreads = 1;
+
+    /* Seed for every system and for making particles, so runs are
+     * repeatable.
+     */
+    uint64_t seed = 106;
+};
+
+struct BenchmarkResult {
+    std::string benchmark;  // Which benchmark, such as "move" or "scene/Fountain"
+    int particles;          // The size it was run at
+    long long operations;   // How many operations were timed
+    double seconds;         // How long they took in total
+
+    /* Average time per operation, in nanoseconds. */
+    double nsPerOp() const;
+};
+
+/* Runs every benchmark at every size in the options and returns the
+ * results, grouped by size. The operations counted are
+ *
+ *   add, add_batch:   one particle added (one at a time or with addAll)
+ *   move, draw:       one particle moved or drawn for one tick
+ *   explode:          one firework exploding into streamers
+ *   churn, scene/...: one live particle for one tick, including making the
+ *                     tick's new particles, moving and drawing
+ */
+std::vector<BenchmarkResult> runParticleBenchmarks(const BenchmarkOptions& options = {});
+
+/* Writes results as a JSON object holding the options they were run with
+ * and an array of results.
+ */
+void writeBenchmarkJson(std::ostream& out, const BenchmarkOptions& options,
+                        const std::vector<BenchmarkResult>& results);
@@ -0,0 +1,62 @@
+/******************************************************************************
+ * File: ParticleBounds.h
+ *
+ * The region a particle system keeps its particles in. Particles outside
+ * the region are never added and are removed as soon as they leave it.
+ * Each side can be left open, so a system can, say, cull particles that
+ * fall off the bottom of the screen while letting them fly as high as they
+ * like.
+ */
+#pragma once
+
+#include <limits>
+
+/* Dimensions of a graphics scene. By default, particles that move outside
+ * the bounding box [0, SCENE_WIDTH) x [0, SCENE_HEIGHT) disappear.
+ */
+const double SCENE_WIDTH  = 800;
+const double SCENE_HEIGHT = 600;
+
+/* A box [minX, maxX) x [minY, maxY). An open side is represented by an
+ * infinite coordinate.
+ */
+struct ParticleBounds {
+    double minX = 0, minY = 0;
+    double maxX = SCENE_WIDTH, maxY = SCENE_HEIGHT;
+
+    /* The box [x, x + width) x [y, y + height). */
+    static ParticleBounds rectangle(double x, double y, double width, double height) {
+        ParticleBounds result;
+        result.minX = x;
+        result.minY = y;
+        result.maxX = x + width;
+        result.maxY = y + height;
+        return result;
+    }
+
+    /* No bounds at all; particles are only removed when they expire. */
+    static ParticleBounds unbounded() {
+        return ParticleBounds().withOpenX().withOpenY();
+    }
+
+    /* The same box, with no limit on x or on y. */
+    ParticleBounds withOpenX() const {
+        ParticleBounds result = *this;
+        result.minX = -kOpen;
+        result.maxX = kOpen;
+        return result;
+    }
+    ParticleBounds withOpenY() const {
+        ParticleBounds result = *this;
+        result.minY = -kOpen;
+        result.maxY = kOpen;
+        return result;
+    }
+
+    /* Whether the point (x, y) is inside the box. */
+    bool contains(double x, double y) const {
+        return x >= minX && x < maxX && y >= minY && y < maxY;
+    }
+
+    static constexpr double kOpen = std::numeric_limits<double>::infinity();
+};
@@ -0,0 +1,406 @@
+/*
+ * Implementation of the particle kernels. The vectorized versions are only
+ * compiled for x86 with GCC or Clang, where each function can be built for
+ * its own instruction set and chosen at runtime. Everywhere else the scalar
+ * versions are used.
+ */
+#include "ParticleKernels.h"
+#include "GUI/SimpleTest.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+using namespace std;
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PARTICLE_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+void integrateParticlesScalar(double* x, double* y, const double* dx, double* dy,
+                              int* lifetime, int count, bool gravity) {
+    for (int i = 0; i < count; i++) {
+        x[i] += dx[i];
+        y[i] += dy[i];
+        lifetime[i]--;
+        if (gravity) {
+            dy[i]++;
+        }
+    }
+}
+
+#ifdef PARTICLE_KERNELS_X86
+namespace {
+    /* SSE2 version: two doubles per register, so four particles per loop
+     * iteration to line up with the four lifetimes in an integer register.
+     * Gravity is a template parameter so each loop body is branch-free.
+     */
+    template <bool kGravity>
+    __attribute__((target("sse2")))
+    void integrateSSE2(double* x, double* y, const double* dx, double* dy,
+                       int* lifetime, int count) {
+        const __m128d one    = _mm_set1_pd(1.0);
+        const __m128i oneInt = _mm_set1_epi32(1);
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            for (int half = 0; half < 4; half += 2) {
+                __m128d vdy = _mm_loadu_pd(dy + i + half);
+                _mm_storeu_pd(x + i + half, _mm_add_pd(_mm_loadu_pd(x + i + half), _mm_loadu_pd(dx + i + half)));
+                _mm_storeu_pd(y + i + half, _mm_add_pd(_mm_loadu_pd(y + i + half), vdy));
+                if (kGravity) {
+                    _mm_storeu_pd(dy + i + half, _mm_add_pd(vdy, one));
+                }
+            }
+
+            __m128i life = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lifetime + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lifetime + i), _mm_sub_epi32(life, oneInt));
+        }
+
+        integrateParticlesScalar(x + i, y + i, dx + i, dy + i, lifetime + i, count - i, kGravity);
+    }
+
+    /* AVX2 version: four doubles per register, eight particles per loop
+     * iteration so the lifetimes fill a whole integer register.
+     */
+    template <bool kGravity>
+    __attribute__((target("avx2")))
+    void integrateAVX2(double* x, double* y, const double* dx, double* dy,
+                       int* lifetime, int count) {
+        const __m256d one    = _mm256_set1_pd(1.0);
+        const __m256i oneInt = _mm256_set1_epi32(1);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            for (int half = 0; half < 8; half += 4) {
+                __m256d vdy = _mm256_loadu_pd(dy + i + half);
+                _mm256_storeu_pd(x + i + half, _mm256_add_pd(_mm256_loadu_pd(x + i + half), _mm256_loadu_pd(dx + i + half)));
+                _mm256_storeu_pd(y + i + half, _mm256_add_pd(_mm256_loadu_pd(y + i + half), vdy));
+                if (kGravity) {
+                    _mm256_storeu_pd(dy + i + half, _mm256_add_pd(vdy, one));
+                }
+            }
+
+            __m256i life = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lifetime + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lifetime + i), _mm256_sub_epi32(life, oneInt));
+        }
+
+        integrateSSE2<kGravity>(x + i, y + i, dx + i, dy + i, lifetime + i, count - i);
+    }
+}
+#endif
+
+namespace {
+    using IntegrateFunction = void (*)(double*, double*, const double*, double*, int*, int);
+
+    template <bool kGravity> void integrateScalar(double* x, double* y, const double* dx, double* dy,
+                                                  int* lifetime, int count) {
+        integrateParticlesScalar(x, y, dx, dy, lifetime, count, kGravity);
+    }
+
+    /* Picks the fastest integration kernel this CPU can run. */
+    template <bool kGravity> IntegrateFunction chooseIntegrate() {
+#ifdef PARTICLE_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return integrateAVX2<kGravity>;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return integrateSSE2<kGravity>;
+        }
+#endif
+        return integrateScalar<kGravity>;
+    }
+}
+
+void integrateParticles(double* x, double* y, const double* dx, double* dy,
+                        int* lifetime, int count, bool gravity) {
+    static const IntegrateFunction withGravity    = chooseIntegrate<true>();
+    static const IntegrateFunction withoutGravity = chooseIntegrate<false>();
+    (gravity ? withGravity : withoutGravity)(x, y, dx, dy, lifetime, count);
+}
+
+void markValidParticlesScalar(const double* x, const double* y, const int* lifetime,
+                              int count, const ParticleBounds& bounds, unsigned char* valid) {
+    /* Bitwise & rather than && so there's nothing to branch on. */
+    for (int i = 0; i < count; i++) {
+        valid[i] = (lifetime[i] >= 0) &
+                   (x[i] >= bounds.minX) & (x[i] < bounds.maxX) &
+                   (y[i] >= bounds.minY) & (y[i] < bounds.maxY);
+    }
+}
+
+#ifdef PARTICLE_KERNELS_X86
+namespace {
+    /* Writes the low 'count' bits of 'mask' out as one byte per bit. */
+    inline void storeMask(unsigned mask, int count, unsigned char* valid) {
+        for (int bit = 0; bit < count; bit++) {
+            valid[bit] = (mask >> bit) & 1;
+        }
+    }
+
+    /* SSE2 version: tests two particles' coordinates per comparison and four
+     * lifetimes at once, then turns the comparison results into a bit mask.
+     * The ordered comparisons are false for NaN, as in the scalar version.
+     */
+    __attribute__((target("sse2")))
+    void markValidSSE2(const double* x, const double* y, const int* lifetime,
+                       int count, const ParticleBounds& bounds, unsigned char* valid) {
+        const __m128d minX = _mm_set1_pd(bounds.minX), maxX = _mm_set1_pd(bounds.maxX);
+        const __m128d minY = _mm_set1_pd(bounds.minY), maxY = _mm_set1_pd(bounds.maxY);
+        const __m128i minusOne = _mm_set1_epi32(-1);
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            unsigned mask = 0;
+            for (int half = 0; half < 4; half += 2) {
+                __m128d vx = _mm_loadu_pd(x + i + half);
+                __m128d vy = _mm_loadu_pd(y + i + half);
+                __m128d inside = _mm_and_pd(_mm_and_pd(_mm_cmpge_pd(vx, minX), _mm_cmplt_pd(vx, maxX)),
+                                            _mm_and_pd(_mm_cmpge_pd(vy, minY), _mm_cmplt_pd(vy, maxY)));
+                mask |= unsigned(_mm_movemask_pd(inside)) << half;
+            }
+
+            __m128i life = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lifetime + i));
+            mask &= unsigned(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(life, minusOne))));
+            storeMask(mask, 4, valid + i);
+        }
+
+        markValidParticlesScalar(x + i, y + i, lifetime + i, count - i, bounds, valid + i);
+    }
+
+    /* AVX2 version: four particles' coordinates per comparison and eight
+     * lifetimes at once.
+     */
+    __attribute__((target("avx2")))
+    void markValidAVX2(const double* x, const double* y, const int* lifetime,
+                       int count, const ParticleBounds& bounds, unsigned char* valid) {
+        const __m256d minX = _mm256_set1_pd(bounds.minX), maxX = _mm256_set1_pd(bounds.maxX);
+        const __m256d minY = _mm256_set1_pd(bounds.minY), maxY = _mm256_set1_pd(bounds.maxY);
+        const __m256i minusOne = _mm256_set1_epi32(-1);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            unsigned mask = 0;
+            for (int half = 0; half < 8; half += 4) {
+                __m256d vx = _mm256_loadu_pd(x + i + half);
+                __m256d vy = _mm256_loadu_pd(y + i + half);
+                __m256d inside = _mm256_and_pd(
+                    _mm256_and_pd(_mm256_cmp_pd(vx, minX, _CMP_GE_OQ), _mm256_cmp_pd(vx, maxX, _CMP_LT_OQ)),
+                    _mm256_and_pd(_mm256_cmp_pd(vy, minY, _CMP_GE_OQ), _mm256_cmp_pd(vy, maxY, _CMP_LT_OQ)));
+                mask |= unsigned(_mm256_movemask_pd(inside)) << half;
+            }
+
+            __m256i life = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lifetime + i));
+            mask &= unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(life, minusOne))));
+            storeMask(mask, 8, valid + i);
+        }
+
+        markValidSSE2(x + i, y + i, lifetime + i, count - i, bounds, valid + i);
+    }
+}
+#endif
+
+namespace {
+    using MarkValidFunction = void (*)(const double*, const double*, const int*, int,
+                                       const ParticleBounds&, unsigned char*);
+
+    /* Picks the fastest culling kernel this CPU can run. */
+    MarkValidFunction chooseMarkValid() {
+#ifdef PARTICLE_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return markValidAVX2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return markValidSSE2;
+        }
+#endif
+        return markValidParticlesScalar;
+    }
+}
+
+void markValidParticles(const double* x, const double* y, const int* lifetime,
+                        int count, const ParticleBounds& bounds, unsigned char* valid) {
+    static const MarkValidFunction markValid = chooseMarkValid();
+    markValid(x, y, lifetime, count, bounds, valid);
+}
+
+void markValidParticles(const float* x, const float* y, const int16_t* lifetime,
+                        int count, const ParticleBounds& bounds, unsigned char* valid) {
+    for (int i = 0; i < count; i++) {
+        double px = x[i], py = y[i];
+        valid[i] = (lifetime[i] >= 0) &
+                   (px >= bounds.minX) & (px < bounds.maxX) &
+                   (py >= bounds.minY) & (py < bounds.maxY);
+    }
+}
+
+void addToVelocities(double* dx, double* dy, int count, double ax, double ay) {
+    for (int i = 0; i < count; i++) {
+        dx[i] += ax;
+        dy[i] += ay;
+    }
+}
+
+namespace {
+    /* How far inside each edge to aim when working out when a particle
+     * leaves, so that rounding error in the particle's motion never matters.
+     */
+    double margin(double edge) {
+        return 1e-6 + 1e-9 * fabs(edge);
+    }
+
+    /* Roughly the first move k >= 1 after which p + k * v leaves
+     * [low, high), erring early. Infinite if it never does.
+     */
+    double linearExit(double p, double v, double low, double high) {
+        const double kNever = numeric_limits<double>::infinity();
+        if (v > 0) {
+            return high == kNever ? kNever : ceil((high - margin(high) - p) / v);
+        }
+        if (v < 0) {
+            return low == -kNever ? kNever : ceil((p - low - margin(low)) / -v);
+        }
+        return kNever;
+    }
+
+    /* The same for a particle that falls with gravity. After k moves it is
+     * at p + k * v + k(k - 1) / 2, so this solves a quadratic for each edge.
+     */
+    double ballisticExit(double p, double v, double low, double high) {
+        const double kNever = numeric_limits<double>::infinity();
+        double b = v - 0.5;
+        double result = kNever;
+
+        /* It always falls out the bottom eventually. */
+        if (high != kNever) {
+            double c = p - (high - margin(high));
+            result = c >= 0 ? 1 : ceil(-b + sqrt(b * b - 2 * c));
+        }
+
+        /* It only goes out the top if it's rising fast enough. */
+        if (low != -kNever && b < 0) {
+            double c = p - (low + margin(low));
+            double discriminant = b * b - 2 * c;
+            if (c <= 0) {
+                result = 1;
+            }
+            else if (discriminant >= 0) {
+                result = min(result, ceil(-b - sqrt(discriminant)));
+            }
+        }
+        return result;
+    }
+}
+
+long long movesUntilCheck(double x, double y, double dx, double dy, int lifetime,
+                          bool gravity, const ParticleBounds& bounds, long long limit) {
+    if (!isfinite(x) || !isfinite(y) || !isfinite(dx) || !isfinite(dy)) {
+        return 1;
+    }
+
+    /* Leaving the bounds is checked one move early, which covers any
+     * rounding in working out the move. Running out of lifetime is exact.
+     */
+    double exit = min(linearExit(x, dx, bounds.minX, bounds.maxX),
+                      gravity ? ballisticExit(y, dy, bounds.minY, bounds.maxY)
+                              : linearExit(y, dy, bounds.minY, bounds.maxY));
+    double moves = min(double(lifetime) + 1, exit - 1);
+
+    if (!(moves >= 1)) return 1;
+    if (moves >= limit) return limit;
+    return (long long)moves;
+}
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("vectorized integration matches the scalar version") {
+    /* Odd sizes exercise the leftover particles after the vector loop. */
+    for (int count: { 0, 1, 3, 4, 7, 8, 13, 64, 101 }) {
+        for (bool gravity: { false, true }) {
+            vector<double> x, y, dx, dy;
+            vector<int> lifetime;
+            for (int i = 0; i < count; i++) {
+                x.push_back(randomReal(0, 800));
+                y.push_back(randomReal(0, 600));
+                dx.push_back(randomReal(-5, 5));
+                dy.push_back(i % 5 == 0 ? -0.0 : randomReal(-5, 5));
+                lifetime.push_back(randomInteger(0, 100));
+            }
+
+            /* Copies for the scalar reference. */
+            vector<double> sx = x, sy = y, sdy = dy;
+            vector<int> slifetime = lifetime;
+
+            for (int step = 0; step < 3; step++) {
+                integrateParticles(x.data(), y.data(), dx.data(), dy.data(),
+                                   lifetime.data(), count, gravity);
+                integrateParticlesScalar(sx.data(), sy.data(), dx.data(), sdy.data(),
+                                         slifetime.data(), count, gravity);
+            }
+
+            for (int i = 0; i < count; i++) {
+                EXPECT_EQUAL(x[i], sx[i]);
+                EXPECT_EQUAL(y[i], sy[i]);
+                EXPECT_EQUAL(dy[i], sdy[i]);
+                EXPECT_EQUAL(signbit(dy[i]), signbit(sdy[i]));
+                EXPECT_EQUAL(lifetime[i], slifetime[i]);
+            }
+        }
+    }
+}
+
+STUDENT_TEST("vectorized culling matches the scalar version") {
+    const double kNaN = numeric_limits<double>::quiet_NaN();
+    ParticleBounds scene;
+    for (ParticleBounds bounds: { scene, scene.withOpenY(), ParticleBounds::rectangle(100, 50, 200, 100),
+                                  ParticleBounds::unbounded() }) {
+        for (int count: { 0, 1, 3, 4, 7, 8, 13, 64, 101 }) {
+            vector<double> x, y;
+            vector<int> lifetime;
+            for (int i = 0; i < count; i++) {
+                /* Include the edges themselves and a NaN. */
+                x.push_back(i % 7 == 0 ? bounds.minX : randomReal(-100, 900));
+                y.push_back(i % 11 == 0 ? 600 : i % 13 == 5 ? kNaN : randomReal(-100, 700));
+                lifetime.push_back(randomInteger(-2, 2));
+            }
+
+            vector<unsigned char> valid(count), expected(count);
+            markValidParticles(x.data(), y.data(), lifetime.data(), count, bounds, valid.data());
+            markValidParticlesScalar(x.data(), y.data(), lifetime.data(), count, bounds, expected.data());
+            EXPECT(valid == expected);
+        }
+    }
+}
+
+STUDENT_TEST("particles aren't left unchecked past the move they become invalid") {
+    ParticleBounds scene;
+    for (ParticleBounds bounds: { scene, scene.withOpenY(), ParticleBounds::rectangle(100, 50, 200, 100) }) {
+        for (int trial = 0; trial < 2000; trial++) {
+            bool gravity = trial % 2 == 0;
+            double x = randomReal(bounds.minX, min(bounds.maxX, 1000.0));
+            double y = randomReal(max(bounds.minY, -1000.0), min(bounds.maxY, 1000.0));
+            double dx = trial % 7 == 0 ? 0 : randomReal(-20, 20);
+            double dy = trial % 5 == 0 ? randomInteger(-30, 30) : randomReal(-30, 30);
+            int lifetime = trial % 3 == 0 ? randomInteger(0, 50) : A_LONG_TIME;
+
+            long long moves = movesUntilCheck(x, y, dx, dy, lifetime, gravity, bounds, 1000);
+            EXPECT(moves >= 1 && moves <= 1000);
+
+            /* Step the particle the same way the kernels do. It must still
+             * be valid after every move before the check.
+             */
+            for (long long move = 1; move < moves; move++) {
+                x += dx;
+                y += dy;
+                lifetime--;
+                if (gravity) dy++;
+                EXPECT(lifetime >= 0 && bounds.contains(x, y));
+            }
+        }
+    }
+
+    /* A particle that never leaves waits as long as allowed. */
+    EXPECT_EQUAL(movesUntilCheck(10, 10, 0, 0, A_LONG_TIME, false, scene, 100), 100);
+    EXPECT_EQUAL(movesUntilCheck(10, 10, 0, 0, 4, false, scene, 100), 5);
+}
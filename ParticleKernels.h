@@ -0,0 +1,61 @@
+/******************************************************************************
+ * File: ParticleKernels.h
+ *
+ * Tight loops that run over the arrays of a ParticleStore. The hottest ones
+ * have a plain scalar version plus, on x86 machines, SSE2 and AVX2 versions
+ * that handle several particles per instruction; the fastest version the
+ * CPU supports is picked the first time the kernel is called. The rest are
+ * written without branches so the compiler can vectorize them itself.
+ */
+#pragma once
+
+#include "Particle.h"
+#include "ParticleBounds.h"
+#include <cstdint>
+
+/* Advances 'count' particles by one time step. Each particle moves by its
+ * velocity and loses one unit of lifetime, and then, if 'gravity' is set,
+ * has its dy increased by one. This gives exactly the same results as doing
+ * those steps one particle at a time.
+ */
+void integrateParticles(double* x, double* y, const double* dx, double* dy,
+                        int* lifetime, int count, bool gravity);
+
+/* The scalar version of integrateParticles, always available. This is what
+ * the vectorized versions are tested against.
+ */
+void integrateParticlesScalar(double* x, double* y, const double* dx, double* dy,
+                              int* lifetime, int count, bool gravity);
+
+/* Sets valid[i] to 1 if particle i has a nonnegative lifetime and lies
+ * inside the given bounds, and to 0 otherwise.
+ */
+void markValidParticles(const double* x, const double* y, const int* lifetime,
+                        int count, const ParticleBounds& bounds, unsigned char* valid);
+
+/* The scalar version of markValidParticles, always available. */
+void markValidParticlesScalar(const double* x, const double* y, const int* lifetime,
+                              int count, const ParticleBounds& bounds, unsigned char* valid);
+
+/* The same, for the float positions and 16-bit lifetimes of a
+ * CompactParticleStore. Written without branches, so the compiler
+ * vectorizes it. The bounds are compared in double precision, like
+ * everywhere else, so a float that rounded onto an edge is handled the same
+ * way.
+ */
+void markValidParticles(const float* x, const float* y, const int16_t* lifetime,
+                        int count, const ParticleBounds& bounds, unsigned char* valid);
+
+/* Adds (ax, ay) to the velocities of 'count' particles. */
+void addToVelocities(double* dx, double* dy, int count, double ax, double ay);
+
+/* Returns how many more moves a particle can make before it needs to be
+ * checked for removal, between 1 and 'limit'. The particle's lifetime runs
+ * out after exactly lifetime + 1 moves. When it leaves the bounds is worked
+ * out in closed form: a straight line for streamers, and a parabola when
+ * 'gravity' is set. That answer is made slightly early, so rounding in the
+ * step-by-step motion can never carry the particle out of bounds before the
+ * check. The particle is assumed to be valid now.
+ */
+long long movesUntilCheck(double x, double y, double dx, double dy, int lifetime,
+                          bool gravity, const ParticleBounds& bounds, long long limit);
@@ -0,0 +1,207 @@
+/*
+ * Implementation of the xoshiro256** generator, following the reference
+ * version by David Blackman and Sebastiano Vigna. Seeds are expanded into
+ * the 256 bits of state with splitmix64, as its authors recommend.
+ */
+#include "ParticleRandom.h"
+#include "GUI/SimpleTest.h"
+#include <random>
+using namespace std;
+
+namespace {
+    uint64_t rotl(uint64_t value, int amount) {
+        return (value << amount) | (value >> (64 - amount));
+    }
+
+    /* Advances a splitmix64 generator and returns its next output. */
+    uint64_t splitmix(uint64_t& state) {
+        uint64_t result = (state += 0x9E3779B97F4A7C15ull);
+        result = (result ^ (result >> 30)) * 0xBF58476D1CE4E5B9ull;
+        result = (result ^ (result >> 27)) * 0x94D049BB133111EBull;
+        return result ^ (result >> 31);
+    }
+}
+
+ParticleRandom::ParticleRandom() {
+    random_device device;
+    seed((uint64_t(device()) << 32) | device());
+}
+
+ParticleRandom::ParticleRandom(uint64_t seed) {
+    this->seed(seed);
+}
+
+void ParticleRandom::seed(uint64_t seed) {
+    for (uint64_t& word: _state) {
+        word = splitmix(seed);
+    }
+}
+
+ParticleRandom ParticleRandom::stream(uint64_t seed, uint64_t index) {
+    /* Mix the index in before expanding, so nearby indices don't give
+     * nearby states.
+     */
+    uint64_t mixer = index;
+    return ParticleRandom(seed ^ splitmix(mixer));
+}
+
+uint64_t ParticleRandom::next() {
+    uint64_t result = rotl(_state[1] * 5, 7) * 9;
+    uint64_t shifted = _state[1] << 17;
+
+    _state[2] ^= _state[0];
+    _state[3] ^= _state[1];
+    _state[1] ^= _state[2];
+    _state[0] ^= _state[3];
+    _state[2] ^= shifted;
+    _state[3] = rotl(_state[3], 45);
+
+    return result;
+}
+
+/* A real number in [0, 1) made from the top 53 bits. */
+double ParticleRandom::unit() {
+    return (next() >> 11) * 0x1.0p-53;
+}
+
+/* An integer in [0, bound), without bias, using Lemire's method. */
+uint32_t ParticleRandom::below(uint32_t bound) {
+    uint64_t product = uint64_t(uint32_t(next() >> 32)) * bound;
+    if (uint32_t(product) < bound) {
+        uint32_t threshold = uint32_t(-bound) % bound;
+        while (uint32_t(product) < threshold) {
+            product = uint64_t(uint32_t(next() >> 32)) * bound;
+        }
+    }
+    return product >> 32;
+}
+
+double ParticleRandom::real(double low, double high) {
+    return low + unit() * (high - low);
+}
+
+int ParticleRandom::integer(int low, int high) {
+    return low + int(below(uint32_t(high - low) + 1));
+}
+
+bool ParticleRandom::chance(double probability) {
+    return unit() < probability;
+}
+
+Color ParticleRandom::color() {
+    uint64_t bits = next();
+    return Color(int(bits & 0xFF), int((bits >> 8) & 0xFF), int((bits >> 16) & 0xFF));
+}
+
+void ParticleRandom::reals(double* out, int count, double low, double high) {
+    double range = high - low;
+    for (int i = 0; i < count; i++) {
+        out[i] = low + unit() * range;
+    }
+}
+
+void ParticleRandom::integers(int* out, int count, int low, int high) {
+    uint32_t range = uint32_t(high - low) + 1;
+    for (int i = 0; i < count; i++) {
+        out[i] = low + int(below(range));
+    }
+}
+
+/* The number of failures before a success is floor(log(U) / log(1 - p))
+ * for U uniform in (0, 1]. Using 1 - unit() keeps U away from zero.
+ */
+double ParticleRandom::geometric(double probability) {
+    return std::floor(std::log(1 - unit()) / std::log1p(-probability));
+}
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("generators with the same seed agree") {
+    ParticleRandom one(137), two(137), other(138);
+
+    bool allSame = true;
+    bool anyDifferent = false;
+    for (int i = 0; i < 100; i++) {
+        uint64_t value = one.next();
+        allSame &= (value == two.next());
+        anyDifferent |= (value != other.next());
+    }
+    EXPECT(allSame);
+    EXPECT(anyDifferent);
+
+    /* Reseeding starts over. */
+    ParticleRandom fresh(137);
+    one.seed(137);
+    EXPECT_EQUAL(one.next() == fresh.next(), true);
+}
+
+STUDENT_TEST("random values stay in range") {
+    ParticleRandom random(106);
+
+    bool seen[7] = {};
+    for (int i = 0; i < 10000; i++) {
+        int value = random.integer(-3, 3);
+        EXPECT(value >= -3 && value <= 3);
+        seen[value + 3] = true;
+
+        double real = random.real(2.5, 4);
+        EXPECT(real >= 2.5 && real < 4);
+    }
+    for (bool wasSeen: seen) {
+        EXPECT(wasSeen);
+    }
+
+    int ints[50];
+    random.integers(ints, 50, 2, 10);
+    double reals[50];
+    random.reals(reals, 50, -1, 1);
+    for (int i = 0; i < 50; i++) {
+        EXPECT(ints[i] >= 2 && ints[i] <= 10);
+        EXPECT(reals[i] >= -1 && reals[i] < 1);
+    }
+
+    EXPECT(!random.chance(0));
+    EXPECT(random.chance(1));
+}
+
+STUDENT_TEST("streams are repeatable and distinct") {
+    ParticleRandom a = ParticleRandom::stream(7, 0);
+    ParticleRandom b = ParticleRandom::stream(7, 1);
+    ParticleRandom c = ParticleRandom::stream(7, 0);
+
+    uint64_t first = a.next();
+    EXPECT_EQUAL(first == c.next(), true);
+    EXPECT_EQUAL(first == b.next(), false);
+}
+
+STUDENT_TEST("sparse trials succeed at the right rate") {
+    ParticleRandom random(42);
+
+    /* Every trial succeeds, or none do. */
+    int count = 0;
+    random.forEachSuccess(800, 1, [&](int trial) {
+        EXPECT_EQUAL(trial, count);
+        count++;
+    });
+    EXPECT_EQUAL(count, 800);
+
+    random.forEachSuccess(800, 0, [&](int) {
+        count++;
+    });
+    EXPECT_EQUAL(count, 800);
+
+    /* Successes come in increasing order, within range, at about the
+     * expected rate: 1000 rounds of 800 trials at 1/40 is 20000 on average,
+     * with a standard deviation of about 140.
+     */
+    count = 0;
+    for (int round = 0; round < 1000; round++) {
+        int last = -1;
+        random.forEachSuccess(800, 1.0 / 40, [&](int trial) {
+            EXPECT(trial > last && trial < 800);
+            last = trial;
+            count++;
+        });
+    }
+    EXPECT(count > 19000 && count < 21000);
+}
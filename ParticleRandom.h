@@ -0,0 +1,92 @@
+/******************************************************************************
+ * File: ParticleRandom.h
+ *
+ * A fast, seedable random number generator for creating particles. It uses
+ * the xoshiro256** algorithm, which is far quicker than the shared generator
+ * behind randomReal and friends, and since each particle system owns its own
+ * generator, seeding it makes a run repeatable.
+ *
+ * Code that runs on several threads at once shouldn't share a generator.
+ * Instead, each piece of work can get its own with ParticleRandom::stream,
+ * which gives the same numbers no matter which thread ends up running it.
+ */
+#pragma once
+
+#include "Demos/Color.h"
+#include <cstdint>
+#include <cmath>
+
+class ParticleRandom {
+public:
+    /* Creates a generator seeded from the system's source of randomness. */
+    ParticleRandom();
+
+    /* Creates a generator with the given seed. Generators with the same
+     * seed produce the same numbers.
+     */
+    explicit ParticleRandom(uint64_t seed);
+
+    /* Restarts the generator from the given seed. */
+    void seed(uint64_t seed);
+
+    /* Returns a generator for stream number 'index' of the given seed.
+     * Different indices give unrelated sequences.
+     */
+    static ParticleRandom stream(uint64_t seed, uint64_t index);
+
+    /* Returns 64 random bits. */
+    uint64_t next();
+
+    /* Returns a random real number in [low, high). */
+    double real(double low, double high);
+
+    /* Returns a random integer in [low, high], inclusive. */
+    int integer(int low, int high);
+
+    /* Returns true with the given probability. */
+    bool chance(double probability);
+
+    /* Returns a random color. */
+    Color color();
+
+    /* Fill out[0 .. count) with random reals in [low, high) or random
+     * integers in [low, high]. Faster than asking for them one at a time.
+     */
+    void reals(double* out, int count, double low, double high);
+    void integers(int* out, int count, int low, int high);
+
+    /* Returns how many failures come before the next success in a run of
+     * trials that each succeed with the given probability, which must be
+     * greater than zero.
+     */
+    double geometric(double probability);
+
+    /* Runs 'numTrials' trials that each succeed with the given probability,
+     * calling onSuccess(trial) for each one that does, in increasing order.
+     * Rather than drawing a number per trial, this jumps straight from one
+     * success to the next, so its cost depends on how many trials succeed
+     * and not on how many there are. To cover a grid, number the cells
+     * row * width + column.
+     */
+    template <typename Callback>
+    void forEachSuccess(int numTrials, double probability, Callback onSuccess);
+
+private:
+    uint64_t _state[4];
+
+    double unit();
+    uint32_t below(uint32_t bound);
+};
+
+/* * * * * Implementation Below This Point * * * * */
+
+template <typename Callback>
+void ParticleRandom::forEachSuccess(int numTrials, double probability, Callback onSuccess) {
+    if (probability <= 0) return;
+
+    double trial = probability >= 1 ? 0 : geometric(probability);
+    while (trial < numTrials) {
+        onSuccess(int(trial));
+        trial += 1 + (probability >= 1 ? 0 : geometric(probability));
+    }
+}
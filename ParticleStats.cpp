@@ -0,0 +1,142 @@
+#include "ParticleStats.h"
+#include "GUI/SimpleTest.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+using namespace std;
+
+int ParticleStats::numTicks() const {
+    return _numTicks;
+}
+
+const TickStats& ParticleStats::tick(int age) const {
+    return _ticks[(_next - 1 - age + kWindowSize) % kWindowSize];
+}
+
+long long ParticleStats::peakBytes() const {
+    return _peakBytes;
+}
+
+void ParticleStats::record(const TickStats& stats) {
+    _ticks[_next] = stats;
+    _next = (_next + 1) % kWindowSize;
+    _numTicks = min(_numTicks + 1, int(kWindowSize));
+    _peakBytes = max(_peakBytes, stats.bytes);
+}
+
+void ParticleStats::addDrawTime(double seconds) {
+    if (_numTicks > 0) {
+        _ticks[(_next - 1 + kWindowSize) % kWindowSize].drawSeconds += seconds;
+    }
+}
+
+void ParticleStats::clear() {
+    *this = ParticleStats();
+}
+
+namespace {
+    /* Number of histogram rows. The last row holds everything that took
+     * longer than the row before it.
+     */
+    const int kNumRows = 24;
+
+    /* Width of the longest bar in a histogram. */
+    const int kBarWidth = 40;
+
+    /* Which row a time goes in: row 0 is under 1us, row r is [2^(r-1), 2^r) us. */
+    int rowFor(double seconds) {
+        double micros = seconds * 1e6;
+        if (micros < 1) return 0;
+        return min(kNumRows - 1, 1 + int(log2(micros)));
+    }
+
+    void writeHistogram(ostream& out, const string& title, const int (&counts)[kNumRows]) {
+        out << title << ":" << endl;
+
+        int first = 0, last = kNumRows - 1;
+        while (first < kNumRows && counts[first] == 0) first++;
+        while (last >= 0 && counts[last] == 0) last--;
+        int most = *max_element(counts, counts + kNumRows);
+
+        for (int row = first; row <= last; row++) {
+            ostringstream label;
+            if (row == 0) {
+                label << "< 1us";
+            }
+            else {
+                label << ">= " << (1LL << (row - 1)) << "us";
+            }
+
+            out << "  ";
+            out.width(12);
+            out << label.str() << " | " << string(counts[row] * kBarWidth / most, '#')
+                << " " << counts[row] << endl;
+        }
+    }
+}
+
+void ParticleStats::dump(ostream& out) const {
+    TickStats total;
+    int moveCounts[kNumRows] = {};
+    int drawCounts[kNumRows] = {};
+    for (int age = 0; age < _numTicks; age++) {
+        const TickStats& stats = tick(age);
+        total.moved    += stats.moved;
+        total.spawned  += stats.spawned;
+        total.expired  += stats.expired;
+        total.culled   += stats.culled;
+        total.exploded += stats.exploded;
+        total.moveSeconds += stats.moveSeconds;
+        total.drawSeconds += stats.drawSeconds;
+        moveCounts[rowFor(stats.moveSeconds)]++;
+        drawCounts[rowFor(stats.drawSeconds)]++;
+    }
+
+    out << "Last " << _numTicks << " ticks:" << endl;
+    out << "  moved "    << total.moved
+        << ", spawned "  << total.spawned
+        << ", expired "  << total.expired
+        << ", culled "   << total.culled
+        << ", exploded " << total.exploded << endl;
+    out << "  moving took " << total.moveSeconds << "s, drawing took " << total.drawSeconds << "s" << endl;
+    out << "  peak memory " << _peakBytes << " bytes" << endl;
+
+    if (_numTicks > 0) {
+        writeHistogram(out, "Move time per tick", moveCounts);
+        writeHistogram(out, "Draw time per tick", drawCounts);
+    }
+}
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("stats remember a window of ticks and the peak memory") {
+    ParticleStats stats;
+    int window = ParticleStats::kWindowSize;
+    stats.addDrawTime(1); // No tick yet, so nothing to add to
+    EXPECT_EQUAL(stats.numTicks(), 0);
+
+    for (int i = 0; i < window + 10; i++) {
+        TickStats tick;
+        tick.moved = i;
+        tick.moveSeconds = i * 1e-6;
+        tick.bytes = i == 5 ? 1000 : 10;
+        stats.record(tick);
+    }
+    stats.addDrawTime(0.5);
+
+    EXPECT_EQUAL(stats.numTicks(), window);
+    EXPECT_EQUAL(stats.tick(0).moved, window + 9);
+    EXPECT_EQUAL(stats.tick(0).drawSeconds, 0.5);
+    EXPECT_EQUAL(stats.tick(window - 1).moved, 10);
+    EXPECT_EQUAL(stats.peakBytes(), 1000);
+
+    ostringstream out;
+    stats.dump(out);
+    EXPECT(out.str().find("Move time per tick") != string::npos);
+    EXPECT(out.str().find("peak memory 1000 bytes") != string::npos);
+
+    stats.clear();
+    EXPECT_EQUAL(stats.numTicks(), 0);
+    EXPECT_EQUAL(stats.peakBytes(), 0);
+}
@@ -0,0 +1,68 @@
+/******************************************************************************
+ * File: ParticleStats.h
+ *
+ * Counters and timings for each call to ParticleSystem::moveParticles.
+ *
+ * Collecting them is switched on when building, by defining PARTICLE_STATS
+ * (for example, with -DPARTICLE_STATS). Without it the code that gathers
+ * them isn't compiled at all, so it costs nothing, and a system's stats just
+ * stay empty.
+ */
+#pragma once
+
+#include <ostream>
+
+/* What happened during one tick. */
+struct TickStats {
+    int moved = 0;           // Particles in the system when the tick started
+    int spawned = 0;         // Streamers made by exploding fireworks
+    int expired = 0;         // Particles removed because their lifetime ran out
+    int culled = 0;          // Particles removed for leaving the bounds or being absorbed
+    int exploded = 0;        // Fireworks that exploded (also counted as expired)
+    double moveSeconds = 0;  // Time spent in moveParticles
+    double drawSeconds = 0;  // Time spent in drawParticles after the tick
+    long long bytes = 0;     // Memory held by the system at the end of the tick
+};
+
+/* The stats for the last kWindowSize ticks, plus the most memory the system
+ * has ever held.
+ */
+class ParticleStats {
+public:
+    static const int kWindowSize = 256;
+
+    /* Number of ticks remembered, up to kWindowSize. */
+    int numTicks() const;
+
+    /* Stats for a remembered tick, where 0 is the latest tick, 1 the one
+     * before, and so on.
+     */
+    const TickStats& tick(int age) const;
+
+    /* Most memory, in bytes, held at the end of any tick so far. */
+    long long peakBytes() const;
+
+    /* Adds the stats for a new tick, forgetting the oldest if the window is
+     * full.
+     */
+    void record(const TickStats& stats);
+
+    /* Adds drawing time to the latest tick. Has no effect before the first
+     * tick.
+     */
+    void addDrawTime(double seconds);
+
+    /* Forgets everything. */
+    void clear();
+
+    /* Writes totals for the remembered ticks, then histograms of how long
+     * moving and drawing took, with one row per power of two microseconds.
+     */
+    void dump(std::ostream& out) const;
+
+private:
+    TickStats _ticks[kWindowSize];
+    int _numTicks = 0;
+    int _next = 0;  // Where the next tick goes
+    long long _peakBytes = 0;
+};
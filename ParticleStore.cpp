@@ -0,0 +1,32 @@
+/*
+ * Implementation of the parts of ParticleStore that ParticleSystem adds to
+ * the arrays every store has (see ParticleArrays in ParticleStore.h).
+ */
+#include "ParticleStore.h"
+#include <algorithm>
+using namespace std;
+
+void ParticleStore::push(const Particle& particle, long long particleSerial) {
+    ParticleArrays::push(particle);
+    serial.back() = particleSerial;
+}
+
+void ParticleStore::sortBySerial() {
+    if (is_sorted(serial.begin(), serial.end())) return;
+
+    vector<int> order(size());
+    for (int i = 0; i < size(); i++) {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+        return serial[lhs] < serial[rhs];
+    });
+
+    ParticleStore sorted;
+    sorted.reserve(capacity());
+    for (int index: order) {
+        sorted.push(get(index), serial[index]);
+        sorted.birth.back() = birth[index];
+    }
+    swap(*this, sorted);
+}
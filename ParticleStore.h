@@ -0,0 +1,309 @@
+/******************************************************************************
+ * File: ParticleStore.h
+ *
+ * Structure-of-arrays storage for particles. Rather than keeping each
+ * Particle as one object, every field lives in its own contiguous array, so
+ * particle number i is spread across x[i], y[i], dx[i], and so on. Loops
+ * that only need a few fields (moving particles only touches positions,
+ * velocities, and lifetimes) then stream through memory instead of hopping
+ * from one heap cell to the next.
+ */
+#pragma once
+
+#include "Particle.h"
+#include "ParticleBounds.h"
+#include "ParticleKernels.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/* Number of particles the store grows by at a time. Growing in large slabs
+ * means a scene that adds a few dozen particles per tick touches the heap
+ * only once in a long while, rather than every time an array fills up.
+ */
+const int PARTICLE_SLAB_SIZE = 4096;
+
+/* The arrays every kind of particle store has, and the operations on them,
+ * written once for any field types. 'Real' is the type of the positions and
+ * velocities, 'Lifetime' the type of the lifetimes and 'StoredColor' the
+ * type of the colors. Lifetimes too long for 'Lifetime' are cut down to the
+ * longest it holds.
+ *
+ * 'Store' is the store type deriving from this one. A store with more
+ * arrays of its own lists them in a static forEachArray(store, fn) that
+ * calls fn on each of its arrays, including the ones here, so that growing,
+ * shrinking and moving particles keeps every array the same length.
+ */
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+struct ParticleArrays {
+    /* Particle positions and velocities. */
+    std::vector<Real> x, y;
+    std::vector<Real> dx, dy;
+
+    /* Remaining lifetimes and particle types. */
+    std::vector<Lifetime> lifetime;
+    std::vector<ParticleType> type;
+
+    /* Particle colors. Only needed when drawing. */
+    std::vector<StoredColor> color;
+
+    /* Number of particles stored. */
+    int size() const;
+
+    /* Number of particles that fit before the arrays need to grow. Removing
+     * particles never shrinks this, so slots freed by dead particles are
+     * reused by the next ones added.
+     */
+    int capacity() const;
+
+    /* Bytes of memory held by the arrays, including room reserved for
+     * particles not yet added.
+     */
+    long long bytesReserved() const;
+
+    /* Makes room for at least the given number of particles, growing every
+     * array in one step.
+     */
+    void reserve(int capacity);
+
+    /* Makes sure 'count' more particles fit, growing the arrays the same
+     * way push does. Use this before adding a batch of particles.
+     */
+    void reserveMore(int count);
+
+    /* Appends a particle to the end of the store. This does not check
+     * whether the particle is valid; that's the particle system's job.
+     */
+    void push(const Particle& particle);
+
+    /* Appends 'count' particles, calling generate(particle) to fill in each
+     * one, and returns the index of the first. Room for all of them is made
+     * up front and each is written straight into the arrays. Like push, this
+     * doesn't check whether the particles are valid. A count of zero or less
+     * adds nothing.
+     */
+    template <typename Generator> int emit(int count, Generator generate);
+
+    /* Removes the particles from index 'begin' onward that have a negative
+     * lifetime or lie outside the given bounds. The rest keep their order.
+     * Meant for checking a batch of particles that was just added.
+     */
+    void removeInvalid(int begin, const ParticleBounds& bounds);
+
+    /* Overwrites the particle at the given index. */
+    void set(int index, const Particle& particle);
+
+    /* Reassembles the particle at the given index into a Particle. */
+    Particle get(int index) const;
+
+    /* Copies the particle at index 'from' over the particle at index 'to'.
+     * Used to compact the store when particles are removed.
+     */
+    void move(int from, int to);
+
+    /* Removes the particle at the given index by moving the last particle
+     * into its slot. Runs in time O(1), but does not preserve order.
+     */
+    void swapRemove(int index);
+
+    /* Shrinks (or grows) the store to the given number of particles. */
+    void resize(int size);
+
+    /* Removes all particles. */
+    void clear();
+
+    /* Calls fn(array) on each of the arrays above. */
+    template <typename Self, typename Function> static void forEachArray(Self& store, Function fn);
+
+private:
+    Store& self();
+    const Store& self() const;
+};
+
+/* The store ParticleSystem uses, with full-size fields, and with the extra
+ * arrays it needs to keep particles of several types in order.
+ */
+struct ParticleStore: ParticleArrays<ParticleStore, double, int, Color> {
+    /* When each particle was added, as a count of particles added before it.
+     * Lets particles split across several stores be drawn in the order they
+     * were added.
+     */
+    std::vector<long long> serial;
+
+    /* The move a particle's position, velocity and lifetime were recorded
+     * at. Only used by particle systems that work out positions on demand
+     * rather than moving every particle each tick; zero otherwise.
+     */
+    std::vector<long long> birth;
+
+    /* Appends a particle with the given serial number. */
+    void push(const Particle& particle, long long serial = 0);
+
+    /* Puts the particles back in order of their serial numbers. */
+    void sortBySerial();
+
+    template <typename Self, typename Function> static void forEachArray(Self& store, Function fn);
+};
+
+/* * * * * Implementation Below This Point * * * * */
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+Store& ParticleArrays<Store, Real, Lifetime, StoredColor>::self() {
+    return static_cast<Store&>(*this);
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+const Store& ParticleArrays<Store, Real, Lifetime, StoredColor>::self() const {
+    return static_cast<const Store&>(*this);
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+template <typename Self, typename Function>
+void ParticleArrays<Store, Real, Lifetime, StoredColor>::forEachArray(Self& store, Function fn) {
+    fn(store.x);
+    fn(store.y);
+    fn(store.dx);
+    fn(store.dy);
+    fn(store.lifetime);
+    fn(store.type);
+    fn(store.color);
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+int ParticleArrays<Store, Real, Lifetime, StoredColor>::size() const {
+    return x.size();
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+int ParticleArrays<Store, Real, Lifetime, StoredColor>::capacity() const {
+    return x.capacity();
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+long long ParticleArrays<Store, Real, Lifetime, StoredColor>::bytesReserved() const {
+    long long result = 0;
+    Store::forEachArray(self(), [&](const auto& array) {
+        result += array.capacity() * sizeof(array[0]);
+    });
+    return result;
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+void ParticleArrays<Store, Real, Lifetime, StoredColor>::reserve(int capacity) {
+    Store::forEachArray(self(), [&](auto& array) {
+        array.reserve(capacity);
+    });
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+void ParticleArrays<Store, Real, Lifetime, StoredColor>::reserveMore(int count) {
+    /* Grow by at least a full slab, and double once the store is large. */
+    if (size() + count > capacity()) {
+        reserve(std::max(size() + count, capacity() + std::max(capacity(), PARTICLE_SLAB_SIZE)));
+    }
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+void ParticleArrays<Store, Real, Lifetime, StoredColor>::push(const Particle& particle) {
+    reserveMore(1);
+    resize(size() + 1);
+    set(size() - 1, particle);
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+template <typename Generator>
+int ParticleArrays<Store, Real, Lifetime, StoredColor>::emit(int count, Generator generate) {
+    int first = size();
+    if (count <= 0) return first;
+
+    reserveMore(count);
+    resize(first + count);
+
+    for (int i = first; i < first + count; i++) {
+        Particle particle;
+        generate(particle);
+        set(i, particle);
+    }
+    return first;
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+void ParticleArrays<Store, Real, Lifetime, StoredColor>::removeInvalid(int begin, const ParticleBounds& bounds) {
+    int count = size() - begin;
+    if (count <= 0) return;
+
+    /* Reused between calls so that checking a batch doesn't allocate. */
+    static thread_local std::vector<unsigned char> valid;
+    valid.resize(count);
+    markValidParticles(&x[begin], &y[begin], &lifetime[begin], count, bounds, valid.data());
+
+    int numKept = begin;
+    for (int i = begin; i < size(); i++) {
+        if (valid[i - begin]) {
+            if (numKept != i) {
+                move(i, numKept);
+            }
+            numKept++;
+        }
+    }
+    resize(numKept);
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+void ParticleArrays<Store, Real, Lifetime, StoredColor>::set(int index, const Particle& particle) {
+    x[index] = particle.x;
+    y[index] = particle.y;
+    dx[index] = particle.dx;
+    dy[index] = particle.dy;
+    lifetime[index] = std::clamp<int>(particle.lifetime, std::numeric_limits<Lifetime>::min(),
+                                      std::numeric_limits<Lifetime>::max());
+    type[index] = particle.type;
+    color[index] = particle.color;
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+Particle ParticleArrays<Store, Real, Lifetime, StoredColor>::get(int index) const {
+    Particle result;
+    result.x = x[index];
+    result.y = y[index];
+    result.dx = dx[index];
+    result.dy = dy[index];
+    result.lifetime = lifetime[index];
+    result.type = type[index];
+    result.color = color[index];
+    return result;
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+void ParticleArrays<Store, Real, Lifetime, StoredColor>::move(int from, int to) {
+    Store::forEachArray(self(), [&](auto& array) {
+        array[to] = array[from];
+    });
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+void ParticleArrays<Store, Real, Lifetime, StoredColor>::swapRemove(int index) {
+    int last = size() - 1;
+    if (index != last) {
+        move(last, index);
+    }
+    resize(last);
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+void ParticleArrays<Store, Real, Lifetime, StoredColor>::resize(int size) {
+    Store::forEachArray(self(), [&](auto& array) {
+        array.resize(size);
+    });
+}
+
+template <typename Store, typename Real, typename Lifetime, typename StoredColor>
+void ParticleArrays<Store, Real, Lifetime, StoredColor>::clear() {
+    resize(0);
+}
+
+template <typename Self, typename Function> void ParticleStore::forEachArray(Self& store, Function fn) {
+    ParticleArrays::forEachArray(store, fn);
+    fn(store.serial);
+    fn(store.birth);
+}
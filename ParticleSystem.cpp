@@ -1,254 +1,2191 @@
 /*
- * This file is a system containing individual units called particles and take in ParticleCell, Particle, and Color parameters.
+ * This file is a system containing individual units called particles and take in Particle and Color parameters.
  * The functions add new particlse to the scene, count the number of particles, draw the particles, and move the particles throughout
  * space. The functions are all void except for returning the number of particles.
  */
 #include "ParticleSystem.h"
+#include "ParticleKernels.h"
+#include "ParticleBehaviors.h"
 #include <list>
 #include "DrawParticle.h"
+#include "error.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 using namespace std;
 
+/* Number of particles handed to a thread at a time when moving particles. */
+const int kChunkSize = 4096;
+
+/* Smallest batch of particles worth splitting across threads. */
+const int kParallelThreshold = 8 * kChunkSize;
+
 
 /*
  * The constructor initializes all of the member variables needed for
- * an instance of the Particle System class. The head and tail are intialized.
- * The count of particles is initially zero.
+ * an instance of the Particle System class. The particle stores start out
+ * empty, and dead particles are removed in a way that keeps the draw order.
  */
 ParticleSystem::ParticleSystem() {
-    _head = nullptr;
-    _tail = nullptr;
-    _count = 0;
+    _numAdded = 0;
+    _removalPolicy = RemovalPolicy::STABLE;
+    _drawOrder = DrawOrder::INSERTION;
+    _motion = Motion::EAGER;
+    _numChunks = 0;
+    _numMoves = 0;
+    _stepRate = 50;
+    _maxSteps = 8;
+    _stepProgress = 0;
+    _gridStale = true;
+    _neighborCellSize = 16;
+    _interactionRadius = 0;
+}
+
+
+
+/*
+ * tracks number of particles in Particle System
+ */
+int ParticleSystem::numParticles() const {
+    int result = 0;
+    for (const ParticleStore& store: _buckets) {
+        result += store.size();
+    }
+    return result;
+}
+
+
+/*
+ * Helper function bucket takes in a particle type and returns the store holding
+ * the particles of that type.
+ */
+ParticleStore& ParticleSystem::bucket(ParticleType type) {
+    return _buckets[int(type)];
+}
+
+const ParticleStore& ParticleSystem::bucket(ParticleType type) const {
+    return _buckets[int(type)];
+}
+
+
+/*
+ * reserve takes in a number of particles and a particle type, and grows the store for
+ * that type so that many particles fit without allocating more memory.
+ */
+void ParticleSystem::reserve(int numParticles, ParticleType type) {
+    bucket(type).reserve(numParticles);
+}
+
+
+/*
+ * add takes in a Particle parameter called particle. The function adds
+ * a particle to the back of the store for its type. It does not return
+ * anything as it is a void function.
+ */
+void ParticleSystem::add(Particle particle) {
+    // checks if the particle adding is valid
+    if (particle.lifetime < 0 || !_bounds.contains(particle.x, particle.y)) {
+        return;
+    }
+    ParticleStore& store = bucket(particle.type);
+    store.push(particle, _numAdded);
+    _numAdded++;
+    admitFrom(particle.type, store.size() - 1);
+}
+
+
+/*
+ * addAll takes in an array of particles and how many there are. Each particle goes onto
+ * the end of the store for its type, numbered in the order given, and then the new part
+ * of each store is checked all at once and the invalid particles are dropped.
+ */
+void ParticleSystem::addAll(const Particle* particles, int count) {
+    if (count <= 0) return;
+
+    int numOfType[kNumTypes] = {};
+    for (int i = 0; i < count; i++) {
+        numOfType[int(particles[i].type)]++;
+    }
+
+    int firstNew[kNumTypes];
+    for (int type = 0; type < kNumTypes; type++) {
+        firstNew[type] = _buckets[type].size();
+        _buckets[type].reserveMore(numOfType[type]);
+    }
+
+    for (int i = 0; i < count; i++) {
+        bucket(particles[i].type).push(particles[i], _numAdded + i);
+    }
+    _numAdded += count;
+
+    for (int type = 0; type < kNumTypes; type++) {
+        _buckets[type].removeInvalid(firstNew[type], _bounds);
+        admitFrom(ParticleType(type), firstNew[type]);
+    }
+}
+
+void ParticleSystem::addAll(const Vector<Particle>& particles) {
+    if (!particles.isEmpty()) {
+        addAll(&particles[0], particles.size());
+    }
+}
+
+
+/*
+ * draw particles does not take in any parameters. The stores already keep the positions
+ * and colors in arrays, so they are handed to the renderer in batches: one per store when
+ * drawing by type, or merged into a single batch in insertion order. It does not return
+ * anything.
+ */
+void ParticleSystem::drawParticles() const {
+#ifdef PARTICLE_STATS
+    auto start = chrono::steady_clock::now();
+#endif
+
+    if (_drawOrder == DrawOrder::INSERTION) {
+        drawInsertionOrder();
+    }
+    else {
+        for (int type = 0; type < kNumTypes; type++) {
+            if (_buckets[type].size() > 0) {
+                const double* xs;
+                const double* ys;
+                positions(type, xs, ys);
+                drawParticleBatch(xs, ys, _buckets[type].color.data(), _buckets[type].size());
+            }
+        }
+    }
+
+#ifdef PARTICLE_STATS
+    _stats.addDrawTime(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+#endif
+}
+
+
+/*
+ * Helper function positions takes in a particle type and sets xs and ys to arrays of
+ * where the particles of that type are now. Normally that's just the store. With lazy
+ * motion, the positions are worked out from each particle's recorded state: it has moved
+ * by its velocity once per move since then and, unless it's a streamer, sped up by one
+ * each move, so after t moves it has fallen an extra t(t - 1) / 2.
+ */
+void ParticleSystem::positions(int type, const double*& xs, const double*& ys) const {
+    const ParticleStore& store = _buckets[type];
+    if (_motion == Motion::EAGER) {
+        xs = store.x.data();
+        ys = store.y.data();
+        return;
+    }
+
+    vector<double>& lazyX = _lazyX[type];
+    vector<double>& lazyY = _lazyY[type];
+    lazyX.resize(store.size());
+    lazyY.resize(store.size());
+
+    double fall = ParticleType(type) == ParticleType::STREAMER ? 0 : 0.5;
+    for (int i = 0; i < store.size(); i++) {
+        double t = double(_numMoves - store.birth[i]);
+        lazyX[i] = store.x[i] + t * store.dx[i];
+        lazyY[i] = store.y[i] + t * store.dy[i] + fall * t * (t - 1);
+    }
+    xs = lazyX.data();
+    ys = lazyY.data();
+}
+
+
+/*
+ * Helper function drawInsertionOrder draws all particles as one batch in the order they
+ * were added. When all particles share a type, that's just the one store. Otherwise the
+ * stores are merged by their serial numbers, like the merge step of mergesort.
+ */
+void ParticleSystem::drawInsertionOrder() const {
+    int numNonEmpty = 0;
+    int only = 0;
+    const double* xs[kNumTypes];
+    const double* ys[kNumTypes];
+    for (int type = 0; type < kNumTypes; type++) {
+        positions(type, xs[type], ys[type]);
+        if (_buckets[type].size() > 0) {
+            numNonEmpty++;
+            only = type;
+        }
+    }
+    if (numNonEmpty <= 1) {
+        drawParticleBatch(xs[only], ys[only], _buckets[only].color.data(), _buckets[only].size());
+        return;
+    }
+
+    _drawX.clear();
+    _drawY.clear();
+    _drawColor.clear();
+
+    int next[kNumTypes] = {};
+    while (true) {
+        // finds the store whose next particle was added earliest
+        int best = -1;
+        for (int type = 0; type < kNumTypes; type++) {
+            const ParticleStore& store = _buckets[type];
+            if (next[type] < store.size() &&
+                (best == -1 || store.serial[next[type]] < _buckets[best].serial[next[best]])) {
+                best = type;
+            }
+        }
+        if (best == -1) break;
+
+        _drawX.push_back(xs[best][next[best]]);
+        _drawY.push_back(ys[best][next[best]]);
+        _drawColor.push_back(_buckets[best].color[next[best]]);
+        next[best]++;
+    }
+
+    drawParticleBatch(_drawX.data(), _drawY.data(), _drawColor.data(), _drawX.size());
+}
+
+
+/*
+ * Helper function moveChunk takes in a particle type, a range of indices into that type's
+ * store, whether to check the particles, a random number generator for the chunk and a
+ * ChunkResult. It moves the particles in the range with the integration kernel (see
+ * ParticleKernels.h), after applying any forces. If asked to check them, it then uses the culling kernel to record
+ * which particles should be removed and, for fireworks, explodes the ones whose time is
+ * up. It only touches particles in its own range, so different chunks can run at once.
+ */
+void ParticleSystem::moveChunk(ParticleType type, int begin, int end, bool cull,
+                               ParticleRandom& random, ChunkResult& result) {
+    ParticleStore& store = bucket(type);
+    result.spawned.clear();
+    result.kills.clear();
+
+    if (!_forces.isEmpty()) {
+        _forces.apply(type, &store.x[begin], &store.y[begin], &store.dx[begin], &store.dy[begin],
+                      end - begin);
+    }
+    integrateParticles(&store.x[begin], &store.y[begin], &store.dx[begin], &store.dy[begin],
+                       &store.lifetime[begin], end - begin, type != ParticleType::STREAMER);
+    if (!cull) return;
+
+    result.absorbed.assign(end - begin, 0);
+    if (!_colliders.isEmpty()) {
+        collideChunk(type, begin, end, result);
+    }
+
+    // checks the rules if the particle should be removed, lifetime and bounds, for the
+    // whole chunk at once
+    result.valid.resize(end - begin);
+    markValidParticles(&store.x[begin], &store.y[begin], &store.lifetime[begin], end - begin,
+                       _bounds, result.valid.data());
+    for (int i = begin; i < end; i++) {
+        if (!result.valid[i - begin] || result.absorbed[i - begin]) {
+            result.kills.push_back(i);
+        }
+    }
+
+    // fireworks explode when their lifetime runs out, whether or not they're in bounds
+    if (type == ParticleType::FIREWORK) {
+        for (int i = begin; i < end; i++) {
+            if (store.lifetime[i] < 0 && !result.absorbed[i - begin]) {
+                explode(store, i, random, result.spawned);
+            }
+        }
+    }
+}
+
+
+/*
+ * Helper function collideChunk takes in a particle type, a range of indices into that
+ * type's store that have just moved, and the chunk's result. Each particle whose move ran
+ * into a collider is bounced, stopped, or marked as absorbed. The whole move is checked,
+ * so a fast particle can't pass through a thin collider. Where a particle was before the
+ * move is worked out from its velocity, undoing gravity's change to dy.
+ */
+void ParticleSystem::collideChunk(ParticleType type, int begin, int end, ChunkResult& result) {
+    ParticleStore& store = bucket(type);
+    double gravity = type == ParticleType::STREAMER ? 0 : 1;
+
+    for (int i = begin; i < end; i++) {
+        double prevX = store.x[i] - store.dx[i];
+        double prevY = store.y[i] - (store.dy[i] - gravity);
+        int hit = _colliders.findHit(prevX, prevY, store.x[i], store.y[i]);
+        if (hit == -1) continue;
+
+        const Collider& collider = _colliders[hit];
+        if (collider.response == CollisionResponse::ABSORB) {
+            result.absorbed[i - begin] = 1;
+        }
+        else {
+            collider.respond(store.x[i], store.y[i], store.dx[i], store.dy[i], prevX, prevY);
+        }
+    }
+}
+
+
+/*
+ * Helper function explode takes in the firework store, the index of a firework whose
+ * lifetime has run out, a random number generator and a list of spawned particles. It
+ * adds the firework's streamers, all of one random color, to the list, following the
+ * same FireworkExplosion rules as BasicParticleSystem (see ParticleBehaviors.h).
+ */
+void ParticleSystem::explode(const ParticleStore& fireworks, int index, ParticleRandom& random,
+                             vector<Particle>& spawned) {
+    FireworkExplosion::burst(fireworks.x[index], fireworks.y[index], random, [&](const Particle& child) {
+        spawned.push_back(child);
+    });
+}
+
+
+/*
+ * Helper function schedulingChecks returns whether particles are only checked when their
+ * scheduled move comes up, rather than on every move.
+ */
+bool ParticleSystem::schedulingChecks() const {
+    if (movingEveryParticle()) return false;
+    return _motion == Motion::LAZY || _removalPolicy == RemovalPolicy::STABLE;
+}
+
+
+/*
+ * Helper function movingEveryParticle returns whether something can change particles'
+ * velocities partway through their flight, so that every particle has to be moved and
+ * checked on every move.
+ */
+bool ParticleSystem::movingEveryParticle() const {
+    return _interaction || !_colliders.isEmpty() || !_forces.isEmpty();
+}
+
+
+/*
+ * Helper function scheduleCheck takes in a particle type and the index of a valid particle
+ * of that type. It works out how many moves the particle can safely make (see
+ * movesUntilCheck in ParticleKernels.h) and puts it in the timing wheel for that move.
+ * Particles that won't need removing for a long time are checked again when the wheel
+ * runs out of room, and rescheduled then.
+ */
+void ParticleSystem::scheduleCheck(ParticleType type, int index) {
+    if (!schedulingChecks()) return;
+
+    const ParticleStore& store = bucket(type);
+    long long moves = movesUntilCheck(store.x[index], store.y[index], store.dx[index], store.dy[index],
+                                      store.lifetime[index], type != ParticleType::STREAMER, _bounds,
+                                      TimingWheel::kNumSlots - 1);
+    _checks[int(type)].schedule(_numMoves + moves, store.serial[index]);
+}
+
+
+/*
+ * Helper function scheduleFrom takes in a particle type and an index, and schedules every
+ * particle of that type from the index onward.
+ */
+void ParticleSystem::scheduleFrom(ParticleType type, int first) {
+    for (int i = first; i < bucket(type).size(); i++) {
+        scheduleCheck(type, i);
+    }
+}
+
+
+/*
+ * Helper function admitFrom takes in a particle type and the index of the first particle
+ * just added to that type's store. It records the move each new particle starts from and
+ * schedules its first check.
+ */
+void ParticleSystem::admitFrom(ParticleType type, int first) {
+    ParticleStore& store = bucket(type);
+    _gridStale = true;
+    for (int i = first; i < store.size(); i++) {
+        store.birth[i] = _numMoves;
+    }
+    scheduleFrom(type, first);
+}
+
+
+/*
+ * Helper function rebase takes in a particle type and an index, and with lazy motion,
+ * brings that particle's recorded position, velocity and lifetime up to the current move.
+ */
+void ParticleSystem::rebase(ParticleType type, int index) {
+    ParticleStore& store = bucket(type);
+    long long moves = _numMoves - store.birth[index];
+    double t = double(moves);
+    double gravity = type == ParticleType::STREAMER ? 0 : 1;
+
+    store.x[index] += t * store.dx[index];
+    store.y[index] += t * store.dy[index] + gravity * t * (t - 1) / 2;
+    store.dy[index] += gravity * t;
+    store.lifetime[index] = int(max<long long>(store.lifetime[index] - moves, -1));
+    store.birth[index] = _numMoves;
+}
+
+
+/*
+ * Helper function rescheduleAll throws out every scheduled check and schedules all the
+ * particles again. Used when the rules for removing particles change. With lazy motion,
+ * the stores hold each particle as it was at its last rebase, so every particle is first
+ * brought up to the current move; otherwise its checks would ignore how old it is.
+ */
+void ParticleSystem::rescheduleAll() {
+    for (int type = 0; type < kNumTypes; type++) {
+        _checks[type].clear();
+        if (_motion == Motion::LAZY) {
+            for (int i = 0; i < _buckets[type].size(); i++) {
+                rebase(ParticleType(type), i);
+            }
+        }
+        if (schedulingChecks()) {
+            _buckets[type].sortBySerial();
+        }
+        scheduleFrom(ParticleType(type), 0);
+    }
+}
+
+
+/*
+ * Helper function runChecks takes in a particle type and the random seed for this tick. It
+ * checks the particles whose scheduled move has just happened, in order. Particles that are
+ * still valid are scheduled again. The rest are recorded for removal and, for fireworks
+ * whose time is up, explode, using the same random number stream per chunk as moveChunk so
+ * the results match checking every particle.
+ */
+void ParticleSystem::runChecks(ParticleType type, uint64_t tickSeed) {
+    ParticleStore& store = bucket(type);
+    vector<long long>& due = _checks[int(type)].due(_numMoves);
+    sort(due.begin(), due.end());
+
+    vector<int>& kills = _chunks[0].kills;
+    int streamChunk = -1;
+    ParticleRandom random(0);
+
+    auto next = store.serial.begin();
+    for (long long serial: due) {
+        next = lower_bound(next, store.serial.end(), serial);
+        int index = next - store.serial.begin();
+        if (_motion == Motion::LAZY) {
+            rebase(type, index);
+        }
+
+        if (store.lifetime[index] >= 0 && _bounds.contains(store.x[index], store.y[index])) {
+            scheduleCheck(type, index);
+            continue;
+        }
+
+        kills.push_back(index);
+        // fireworks explode when their lifetime runs out, whether or not they're in bounds
+        if (type == ParticleType::FIREWORK && store.lifetime[index] < 0) {
+            if (index / kChunkSize != streamChunk) {
+                streamChunk = index / kChunkSize;
+                random = ParticleRandom::stream(tickSeed, streamChunk);
+            }
+            explode(store, index, random, _spawnQueue);
+        }
+    }
+    due.clear();
+}
+
+
+/*
+ * Helper function removeStable takes in a store and slides the particles between the
+ * removed ones down to fill the gaps, so the store is compacted in a single pass and
+ * particles stay in the order they were added. Particles before the first removed one
+ * are already in place, so the pass starts there, and a tick with nothing to remove
+ * doesn't touch the store at all. It returns how many particles were slid down.
+ */
+int ParticleSystem::removeStable(ParticleStore& store) {
+    int chunk = 0;
+    while (chunk < _numChunks && _chunks[chunk].kills.empty()) {
+        chunk++;
+    }
+    if (chunk == _numChunks) return 0;
+
+    int numKept = _chunks[chunk].kills[0];
+    int next = numKept;
+    int numSlid = 0;
+    for (; chunk < _numChunks; chunk++) {
+        for (int kill: _chunks[chunk].kills) {
+            for (int i = next; i < kill; i++) {
+                store.move(i, numKept);
+                numKept++;
+                numSlid++;
+            }
+            next = kill + 1;
+        }
+    }
+    for (int i = next; i < store.size(); i++) {
+        store.move(i, numKept);
+        numKept++;
+        numSlid++;
+    }
+    store.resize(numKept);
+    return numSlid;
+}
+
+
+/*
+ * Helper function removeUnstable takes in a store and removes particles by moving the
+ * last particle into their slot. Going from the highest index down means the last
+ * particle is never one that still needs to be removed.
+ */
+void ParticleSystem::removeUnstable(ParticleStore& store) {
+    for (int chunk = _numChunks - 1; chunk >= 0; chunk--) {
+        const vector<int>& kills = _chunks[chunk].kills;
+        for (int i = int(kills.size()) - 1; i >= 0; i--) {
+            store.swapRemove(kills[i]);
+        }
+    }
+}
+
+
+/*
+ * Helper function moveBucket takes in a particle type and moves every particle of that
+ * type. The store is split into chunks, which are moved in parallel if there are enough
+ * particles and threads. Each chunk gets its own random number stream, numbered by chunk,
+ * so explosions come out the same however the chunks are shared among threads. The
+ * particles are then checked, either all of them chunk by chunk or just the ones scheduled
+ * for this move. With lazy motion, nothing is moved and only the scheduled checks are made.
+ * Streamers are queued in order, and the particles that are no longer valid are removed
+ * using the chosen removal policy.
+ */
+void ParticleSystem::moveBucket(ParticleType type) {
+    ParticleStore& store = bucket(type);
+    int size = store.size();
+
+    uint64_t tickSeed = _random.next();
+    bool scheduled = schedulingChecks();
+
+    if (_motion == Motion::LAZY) {
+        // nothing moves, so there's only the scheduled checks to make
+        _numChunks = min(size, 1);
+        if (_chunks.empty()) {
+            _chunks.resize(1);
+        }
+        _chunks[0].spawned.clear();
+        _chunks[0].kills.clear();
+    }
+    else {
+        _numChunks = (size + kChunkSize - 1) / kChunkSize;
+        if (int(_chunks.size()) < _numChunks) {
+            _chunks.resize(_numChunks);
+        }
+
+        auto moveOne = [&](int chunk) {
+            int begin = chunk * kChunkSize;
+            ParticleRandom random = ParticleRandom::stream(tickSeed, chunk);
+            moveChunk(type, begin, min(size, begin + kChunkSize), !scheduled, random, _chunks[chunk]);
+        };
+        if (_workers != nullptr && size >= kParallelThreshold) {
+            _workers->run(_numChunks, moveOne);
+        }
+        else {
+            for (int chunk = 0; chunk < _numChunks; chunk++) {
+                moveOne(chunk);
+            }
+        }
+    }
+
+    if (scheduled && size > 0) {
+        runChecks(type, tickSeed);
+    }
+    for (int chunk = 0; chunk < _numChunks; chunk++) {
+        const vector<Particle>& spawned = _chunks[chunk].spawned;
+        _spawnQueue.insert(_spawnQueue.end(), spawned.begin(), spawned.end());
+    }
+
+#ifdef PARTICLE_STATS
+    countRemovals(type);
+#endif
+
+    if (scheduled || _removalPolicy == RemovalPolicy::STABLE) {
+        removeStable(store);
+    }
+    else {
+        removeUnstable(store);
+    }
+}
+
+
+/*
+ * Function moveParticles takes in no parameters. This function moves the particles one
+ * type at a time. Streamers from exploding fireworks are held in the spawn queue while
+ * the particles move, and are then added in one batch, so they don't move until the next
+ * tick.
+ */
+void ParticleSystem::moveParticles() {
+#ifdef PARTICLE_STATS
+    auto start = chrono::steady_clock::now();
+    _tickStats = TickStats();
+    _tickStats.moved = numParticles();
+#endif
+
+    if (_interaction) {
+        interact();
+    }
+
+    _numMoves++;
+    moveBucket(ParticleType::FIREWORK);
+    moveBucket(ParticleType::BALLISTIC);
+    moveBucket(ParticleType::STREAMER);
+
+#ifdef PARTICLE_STATS
+    _tickStats.spawned = _spawnQueue.size();
+#endif
+
+    addAll(_spawnQueue.data(), _spawnQueue.size());
+    _spawnQueue.clear();
+    _gridStale = true;
+
+#ifdef PARTICLE_STATS
+    _tickStats.moveSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    _tickStats.bytes = bytesInUse();
+    _stats.record(_tickStats);
+#endif
+}
+
+
+/*
+ * Function moveParticles takes in an amount of time in seconds, adds it to the time built
+ * up from earlier calls, and takes as many whole steps as that time covers, up to the
+ * limit. Runs of steps in which no particle is due to be checked are made in one pass. It
+ * returns the number of steps taken. The limit is checked before the built-up time is made
+ * into a whole number of steps, since a huge dt would overflow an int.
+ */
+int ParticleSystem::moveParticles(double dt) {
+    if (!isfinite(dt)) {
+        error("moveParticles needs a finite amount of time");
+    }
+
+    _stepProgress += max(dt, 0.0) * _stepRate;
+    int numSteps;
+    if (_stepProgress >= _maxSteps + 1.0) {
+        numSteps = _maxSteps;
+        _stepProgress = 0;
+    }
+    else {
+        numSteps = int(_stepProgress);
+        _stepProgress -= numSteps;
+    }
+
+    int stepsLeft = numSteps;
+    while (stepsLeft > 0) {
+        int quiet = quietMoves(stepsLeft);
+        if (quiet >= 2) {
+            moveQuietly(quiet);
+            stepsLeft -= quiet;
+        }
+        else {
+            moveParticles();
+            stepsLeft--;
+        }
+    }
+    return numSteps;
+}
+
+
+/*
+ * Helper function quietMoves takes in a number of moves and returns how many of the next
+ * moves, up to that number, need nothing but moving the particles: no particle is due for a
+ * check, so nothing is removed, explodes or is added. That can only be known ahead of time
+ * when checks are scheduled and particles are moved eagerly; otherwise it returns 0.
+ */
+int ParticleSystem::quietMoves(int limit) {
+    if (_motion != Motion::EAGER || !schedulingChecks()) return 0;
+
+    limit = min(limit, TimingWheel::kNumSlots - 1);
+    for (int moves = 0; moves < limit; moves++) {
+        for (int type = 0; type < kNumTypes; type++) {
+            if (!_checks[type].due(_numMoves + moves + 1).empty()) {
+                return moves;
+            }
+        }
+    }
+    return limit;
+}
+
+
+/*
+ * Helper function moveQuietly takes in a number of moves that quietMoves said need nothing
+ * but moving, and makes them all in one pass: each chunk of particles is moved that many
+ * times while it's in the cache, and the chunks are shared among the threads. The random
+ * number generator is advanced just as that many calls to moveParticles would, so later
+ * explosions come out the same.
+ */
+void ParticleSystem::moveQuietly(int numMoves) {
+#ifdef PARTICLE_STATS
+    auto start = chrono::steady_clock::now();
+    int numMoved = numParticles();
+#endif
+
+    for (int i = 0; i < numMoves * kNumTypes; i++) {
+        _random.next();
+    }
+
+    for (int type = 0; type < kNumTypes; type++) {
+        ParticleStore& store = _buckets[type];
+        int size = store.size();
+        bool gravity = ParticleType(type) != ParticleType::STREAMER;
+
+        auto moveOne = [&](int chunk) {
+            int begin = chunk * kChunkSize;
+            int count = min(size, begin + kChunkSize) - begin;
+            for (int move = 0; move < numMoves; move++) {
+                integrateParticles(&store.x[begin], &store.y[begin], &store.dx[begin], &store.dy[begin],
+                                   &store.lifetime[begin], count, gravity);
+            }
+        };
+        int numChunks = (size + kChunkSize - 1) / kChunkSize;
+        if (_workers != nullptr && size >= kParallelThreshold) {
+            _workers->run(numChunks, moveOne);
+        }
+        else {
+            for (int chunk = 0; chunk < numChunks; chunk++) {
+                moveOne(chunk);
+            }
+        }
+    }
+    _numMoves += numMoves;
+    _gridStale = true;
+
+#ifdef PARTICLE_STATS
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    for (int move = 0; move < numMoves; move++) {
+        TickStats stats;
+        stats.moved = numMoved;
+        stats.moveSeconds = seconds / numMoves;
+        stats.bytes = bytesInUse();
+        _stats.record(stats);
+    }
+#endif
+}
+
+
+/*
+ * Helper function countRemovals takes in a particle type and, before the particles marked
+ * for removal are removed, adds them to this tick's stats: those whose lifetime ran out as
+ * expired, and the rest, including any absorbed by colliders, as culled. Only used when
+ * built with PARTICLE_STATS.
+ */
+void ParticleSystem::countRemovals(ParticleType type) {
+#ifdef PARTICLE_STATS
+    const ParticleStore& store = bucket(type);
+    for (int chunk = 0; chunk < _numChunks; chunk++) {
+        for (int kill: _chunks[chunk].kills) {
+            bool absorbed = !_colliders.isEmpty() && _chunks[chunk].absorbed[kill - chunk * kChunkSize];
+            if (store.lifetime[kill] < 0 && !absorbed) {
+                _tickStats.expired++;
+                if (type == ParticleType::FIREWORK) {
+                    _tickStats.exploded++;
+                }
+            }
+            else {
+                _tickStats.culled++;
+            }
+        }
+    }
+#else
+    (void) type;
+#endif
+}
+
+
+/*
+ * Helper function bytesInUse returns how much memory the system holds: the particle
+ * stores plus the space kept between calls for spawning, moving and drawing particles.
+ */
+long long ParticleSystem::bytesInUse() const {
+    long long result = _spawnQueue.capacity() * sizeof(Particle);
+    for (int type = 0; type < kNumTypes; type++) {
+        result += _buckets[type].bytesReserved();
+        result += (_lazyX[type].capacity() + _lazyY[type].capacity()) * sizeof(double);
+    }
+    result += (_drawX.capacity() + _drawY.capacity()) * sizeof(double);
+    result += _drawColor.capacity() * sizeof(Color);
+    result += _pushes.capacity() * sizeof(Push);
+    result += (_interactDX.capacity() + _interactDY.capacity()) * sizeof(double);
+    result += _interactType.capacity() * sizeof(ParticleType);
+    for (const ChunkResult& chunk: _chunks) {
+        result += chunk.spawned.capacity() * sizeof(Particle);
+        result += chunk.kills.capacity() * sizeof(int);
+        result += chunk.valid.capacity();
+        result += chunk.absorbed.capacity();
+    }
+    return result;
+}
+
+
+/*
+ * Helper function buildGrid files every particle in the neighbor grid, if the particles
+ * have changed since the grid was last built. The stores' positions are joined into one
+ * list, in type order, and the grid is built from that with a counting sort.
+ */
+void ParticleSystem::buildGrid() const {
+    if (!_gridStale) return;
+
+    _gridX.clear();
+    _gridY.clear();
+    for (int type = 0; type < kNumTypes; type++) {
+        const double* xs;
+        const double* ys;
+        positions(type, xs, ys);
+        _gridX.insert(_gridX.end(), xs, xs + _buckets[type].size());
+        _gridY.insert(_gridY.end(), ys, ys + _buckets[type].size());
+    }
+
+    double cellSize = _interaction ? _interactionRadius : _neighborCellSize;
+    bool parallel = _workers != nullptr && int(_gridX.size()) >= kParallelThreshold;
+    _grid.build(_bounds, cellSize, _gridX.data(), _gridY.data(), _gridX.size(),
+                parallel ? _workers.get() : nullptr);
+    _gridStale = false;
+}
+
+
+/*
+ * Helper function storeHolding takes in the number of a particle in the neighbor grid,
+ * changes it to the particle's index in its store, and returns that store.
+ */
+const ParticleStore& ParticleSystem::storeHolding(int& index) const {
+    int type = 0;
+    while (index >= _buckets[type].size()) {
+        index -= _buckets[type].size();
+        type++;
+    }
+    return _buckets[type];
+}
+
+
+/*
+ * Helper function interact gives every particle the pushes from its neighbors. All the
+ * pushes are worked out from the grid before any are applied, so each particle's push
+ * only depends on where things were at the start of the move, and chunks of particles can
+ * be handled by different threads.
+ */
+void ParticleSystem::interact() {
+    buildGrid();
+    int count = _grid.size();
+    _pushes.assign(count, Push());
+
+    _interactDX.clear();
+    _interactDY.clear();
+    _interactType.clear();
+    for (int type = 0; type < kNumTypes; type++) {
+        const ParticleStore& store = _buckets[type];
+        _interactDX.insert(_interactDX.end(), store.dx.begin(), store.dx.end());
+        _interactDY.insert(_interactDY.end(), store.dy.begin(), store.dy.end());
+        _interactType.insert(_interactType.end(), store.size(), ParticleType(type));
+    }
+    InteractionParticles particles = {
+        _gridX.data(), _gridY.data(), _interactDX.data(), _interactDY.data(), _interactType.data()
+    };
+
+    auto pushChunk = [&](int chunk) {
+        int end = min(count, (chunk + 1) * kChunkSize);
+        for (int id = chunk * kChunkSize; id < end; id++) {
+            Push& total = _pushes[id];
+            _grid.forEachNear(_gridX[id], _gridY[id], _interactionRadius, [&](int other, double) {
+                if (other == id) return;
+                Push push = _interaction(particles, id, other);
+                total.dx += push.dx;
+                total.dy += push.dy;
+            });
+        }
+    };
+    int numChunks = (count + kChunkSize - 1) / kChunkSize;
+    if (_workers != nullptr && count >= kParallelThreshold) {
+        _workers->run(numChunks, pushChunk);
+    }
+    else {
+        for (int chunk = 0; chunk < numChunks; chunk++) {
+            pushChunk(chunk);
+        }
+    }
+
+    int id = 0;
+    for (ParticleStore& store: _buckets) {
+        for (int i = 0; i < store.size(); i++, id++) {
+            store.dx[i] += _pushes[id].dx;
+            store.dy[i] += _pushes[id].dy;
+        }
+    }
+}
+
+
+/*
+ * Function setRemovalPolicy takes in a RemovalPolicy and uses it for every later call
+ * to moveParticles.
+ */
+void ParticleSystem::setRemovalPolicy(RemovalPolicy policy) {
+    if (policy != _removalPolicy) {
+        _removalPolicy = policy;
+        rescheduleAll();
+    }
+}
+
+
+/*
+ * Function setDrawOrder takes in a DrawOrder and uses it for every later call to
+ * drawParticles.
+ */
+void ParticleSystem::setDrawOrder(DrawOrder order) {
+    _drawOrder = order;
+}
+
+
+/*
+ * Function setMotion takes in a Motion and uses it from now on. Switching to lazy motion
+ * records every particle's current state as its starting point; switching back works out
+ * where each particle is now and stores that. Lazy motion can't follow interactions,
+ * colliders or forces, so asking for it while any are set is an error.
+ */
+void ParticleSystem::setMotion(Motion motion) {
+    if (motion == Motion::LAZY && movingEveryParticle()) {
+        error("Lazy motion can't be used with interactions, colliders or forces");
+    }
+    if (motion == _motion) return;
+
+    for (int type = 0; type < kNumTypes; type++) {
+        for (int i = 0; i < _buckets[type].size(); i++) {
+            if (_motion == Motion::LAZY) {
+                rebase(ParticleType(type), i);
+            }
+            else {
+                _buckets[type].birth[i] = _numMoves;
+            }
+        }
+    }
+    _motion = motion;
+    rescheduleAll();
+}
+
+
+/*
+ * Function setNeighborCellSize takes in a width for the cells of the neighbor grid, which
+ * is rebuilt with the new size the next time it's used.
+ */
+void ParticleSystem::setNeighborCellSize(double cellSize) {
+    _neighborCellSize = cellSize;
+    _gridStale = true;
+}
+
+
+/*
+ * Function setInteraction takes in a radius and an interaction. From the next move on,
+ * each particle is pushed by the particles within that radius of it. Particles have to be
+ * moved and checked on every move for this, so the system switches to eager motion and
+ * stops scheduling checks.
+ */
+void ParticleSystem::setInteraction(double radius, Interaction interaction) {
+    setMotion(Motion::EAGER);
+    _interaction = interaction;
+    _interactionRadius = radius;
+    _gridStale = true;
+    rescheduleAll();
+}
+
+
+/*
+ * Function addCollider takes in a rectangle, a response and a bounciness, and adds the
+ * rectangle to the ones particles run into. Particles have to be moved and checked on
+ * every move for this, as with interactions.
+ */
+void ParticleSystem::addCollider(double x, double y, double width, double height,
+                                 CollisionResponse response, double bounciness) {
+    setMotion(Motion::EAGER);
+    _colliders.add({ x, y, width, height, response, bounciness });
+    rescheduleAll();
+}
+
+
+/*
+ * Function clearColliders removes every rectangle added with addCollider.
+ */
+void ParticleSystem::clearColliders() {
+    _colliders.clear();
+    rescheduleAll();
+}
+
+
+/*
+ * Function addForce takes in a force and adds it to the ones applied on every move.
+ * Particles have to be moved and checked on every move for this, as with interactions.
+ */
+void ParticleSystem::addForce(const Force& force) {
+    setMotion(Motion::EAGER);
+    _forces.add(force);
+    rescheduleAll();
+}
+
+
+/*
+ * Function clearForces removes every force added with addForce.
+ */
+void ParticleSystem::clearForces() {
+    _forces.clear();
+    rescheduleAll();
+}
+
+
+/*
+ * Functions setStepRate and setMaxStepsPerCall choose how fast moveParticles(dt) steps and
+ * how many steps it may take at once. Function stepProgress returns how much of a step
+ * moveParticles(dt) has built up.
+ */
+void ParticleSystem::setStepRate(double stepsPerSecond) {
+    if (!isfinite(stepsPerSecond) || stepsPerSecond < 0) {
+        error("The step rate must be a finite number of steps per second, at least zero");
+    }
+    _stepRate = stepsPerSecond;
+}
+
+void ParticleSystem::setMaxStepsPerCall(int maxSteps) {
+    if (maxSteps < 0) {
+        error("The most steps per call can't be negative");
+    }
+    _maxSteps = maxSteps;
+}
+
+double ParticleSystem::stepProgress() const {
+    return _stepProgress;
+}
+
+
+/*
+ * Function setThreadCount takes in a number of threads. It starts a pool with that many
+ * threads for moving particles, or gets rid of the pool if only one thread is wanted.
+ */
+void ParticleSystem::setThreadCount(int numThreads) {
+    if (numThreads <= 1) {
+        _workers.reset();
+    }
+    else {
+        _workers.reset(new WorkerPool(numThreads));
+    }
+}
+
+
+/*
+ * Function setBounds takes in a ParticleBounds and uses it to decide which particles are
+ * added and which are removed from now on. Function bounds returns the current bounds.
+ */
+void ParticleSystem::setBounds(const ParticleBounds& bounds) {
+    _bounds = bounds;
+    _colliders.setBounds(bounds);
+    _gridStale = true;
+    rescheduleAll();
+}
+
+ParticleBounds ParticleSystem::bounds() const {
+    return _bounds;
+}
+
+
+/*
+ * Function seed takes in a seed and restarts the system's random number generator from it.
+ */
+void ParticleSystem::seed(uint64_t seed) {
+    _random.seed(seed);
+}
+
+
+/*
+ * Function random returns the system's random number generator.
+ */
+ParticleRandom& ParticleSystem::random() {
+    return _random;
+}
+
+
+/*
+ * Function stats returns the stats for recent ticks. Without PARTICLE_STATS nothing is
+ * recorded, so every system shares the same empty stats.
+ */
+const ParticleStats& ParticleSystem::stats() const {
+#ifdef PARTICLE_STATS
+    return _stats;
+#else
+    static const ParticleStats empty;
+    return empty;
+#endif
+}
+
+
+/* * * * * Test Cases Below This Point * * * * */
+
+#include "Demos/ParticleCatcher.h"
+
+STUDENT_TEST("ignores adding particles outside boundaries") {
+    ParticleSystem system;
+
+    Particle particle;
+    particle.x = -1;
+    particle.y = 10;
+    particle.lifetime = 5;
+
+    system.add(particle);
+
+    EXPECT_EQUAL(system.numParticles(), 0);
+
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 0);
+}
+
+STUDENT_TEST("adding valid particle to empty system") {
+    ParticleSystem system;
+
+    Particle particle;
+    particle.x = 10;
+    particle.y = 20;
+    particle.lifetime = 5;
+
+    system.add(particle);
+
+    EXPECT_EQUAL(system.numParticles(), 1);
+
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 1);
+
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x[0], 10);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).y[0], 20);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).lifetime[0], 5);
+}
+
+STUDENT_TEST("tests the streamer particles have the same color") {
+    ParticleSystem system;
+
+    Particle firework;
+    firework.type = ParticleType::FIREWORK;
+    firework.lifetime = 2;
+    firework.x = 50;
+    firework.y = 50;
+    system.add(firework);
+
+    /* The firework explodes on the third move. */
+    for (int i = 0; i < 3; i++) {
+        system.moveParticles();
+    }
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 50);
+
+    Color streamerColor = system.bucket(ParticleType::STREAMER).color[0];
+
+    for (int i = 0; i < system.bucket(ParticleType::STREAMER).size(); i++) {
+        EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).color[i], streamerColor);
+    }
+}
+
+
+STUDENT_TEST("particle after an exploding firework still moves") {
+    ParticleSystem system;
+
+    Particle firework;
+    firework.type = ParticleType::FIREWORK;
+    firework.lifetime = 0;
+    firework.x = 50;
+    firework.y = 50;
+    system.add(firework);
+
+    Particle streamer;
+    streamer.x = 10;
+    streamer.y = 10;
+    streamer.dx = 1;
+    streamer.color = Color::RED;
+    system.add(streamer);
+
+    system.moveParticles();
+
+    /* The streamer slides to the front of the store and has moved once. */
+    EXPECT_EQUAL(system.numParticles(), 51);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x[0], 11);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).color[0], Color::RED);
+}
+
+STUDENT_TEST("unstable removal keeps every surviving particle") {
+    ParticleSystem system;
+    system.setRemovalPolicy(RemovalPolicy::UNSTABLE);
+
+    /* Particles 0, 2, and 4 die on the first move. */
+    for (int i = 0; i < 6; i++) {
+        Particle particle;
+        particle.x = i;
+        particle.dy = 1;
+        particle.lifetime = (i % 2 == 0) ? 0 : 100;
+        system.add(particle);
+    }
+
+    system.moveParticles();
+    EXPECT_EQUAL(system.numParticles(), 3);
+
+    /* Order isn't guaranteed, but each survivor moved exactly once. */
+    ParticleCatcher catcher;
+    system.drawParticles();
+    EXPECT_EQUAL(catcher.numDrawn(), 3);
+
+    int xTotal = 0;
+    for (int i = 0; i < catcher.numDrawn(); i++) {
+        EXPECT_EQUAL(catcher[i].y, 1);
+        xTotal += int(catcher[i].x);
+    }
+    EXPECT_EQUAL(xTotal, 1 + 3 + 5);
+}
+
+STUDENT_TEST("reserved particle store doesn't move when filled") {
+    ParticleSystem system;
+    system.reserve(10000);
+    double* xs = system.bucket(ParticleType::STREAMER).x.data();
+
+    for (int i = 0; i < 10000; i++) {
+        Particle particle;
+        particle.x = i % 800;
+        system.add(particle);
+    }
+
+    EXPECT_EQUAL(system.numParticles(), 10000);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x.data(), xs);
+}
+
+STUDENT_TEST("dead particle slots are reused by new particles") {
+    ParticleSystem system;
+
+    /* Steady state: as many particles die each tick as are added. */
+    for (int tick = 0; tick < 100; tick++) {
+        for (int i = 0; i < 80; i++) {
+            Particle particle;
+            particle.x = i;
+            particle.lifetime = 3;
+            system.add(particle);
+        }
+        system.moveParticles();
+    }
+
+    /* Never more than four ticks' worth alive, so one slab covers it. */
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).capacity(), PARTICLE_SLAB_SIZE);
+}
+
+STUDENT_TEST("moving particles on many threads matches one thread") {
+    for (RemovalPolicy policy: { RemovalPolicy::STABLE, RemovalPolicy::UNSTABLE }) {
+        ParticleSystem serial, parallel;
+        serial.setRemovalPolicy(policy);
+        parallel.setRemovalPolicy(policy);
+        parallel.setThreadCount(4);
+        serial.seed(106);
+        parallel.seed(106);
+
+        /* Enough particles to be split up, some of which die each tick, and
+         * a few fireworks so that explosions are compared too.
+         */
+        for (int i = 0; i < 100000; i++) {
+            Particle particle;
+            particle.x = randomReal(0, SCENE_WIDTH);
+            particle.y = randomReal(0, SCENE_HEIGHT);
+            particle.dx = randomReal(-10, 10);
+            particle.dy = randomReal(-10, 10);
+            particle.lifetime = randomInteger(0, 20);
+            particle.type = randomChance(0.5) ? ParticleType::STREAMER : ParticleType::BALLISTIC;
+            if (randomChance(0.01)) {
+                particle.type = ParticleType::FIREWORK;
+            }
+            serial.add(particle);
+            parallel.add(particle);
+        }
+
+        for (int tick = 0; tick < 10; tick++) {
+            serial.moveParticles();
+            parallel.moveParticles();
+
+            EXPECT_EQUAL(parallel.numParticles(), serial.numParticles());
+            for (int type = 0; type < ParticleSystem::kNumTypes; type++) {
+                EXPECT(parallel._buckets[type].x == serial._buckets[type].x);
+                EXPECT(parallel._buckets[type].y == serial._buckets[type].y);
+                EXPECT(parallel._buckets[type].dy == serial._buckets[type].dy);
+                EXPECT(parallel._buckets[type].lifetime == serial._buckets[type].lifetime);
+                EXPECT(parallel._buckets[type].dx == serial._buckets[type].dx);
+                EXPECT(parallel._buckets[type].color == serial._buckets[type].color);
+            }
+        }
+    }
+}
+
+STUDENT_TEST("fireworks explode when moved on many threads") {
+    ParticleSystem system;
+    system.setThreadCount(4);
+
+    const int kNumFireworks = 40000;
+    for (int i = 0; i < kNumFireworks; i++) {
+        Particle firework;
+        firework.type = ParticleType::FIREWORK;
+        firework.lifetime = i % 2;
+        firework.x = 100 + i % 400;
+        firework.y = 100 + i % 300;
+        system.add(firework);
+    }
+
+    /* Half explode now, and half on the next tick. */
+    system.moveParticles();
+    EXPECT_EQUAL(system.numParticles(), kNumFireworks / 2 + 50 * kNumFireworks / 2);
+}
+
+STUDENT_TEST("batch draw function gets every particle in one call") {
+    ParticleSystem system;
+    for (int i = 0; i < 5; i++) {
+        Particle particle;
+        particle.x = i;
+        particle.y = 2 * i;
+        particle.color = Color::GREEN;
+        system.add(particle);
+    }
+
+    int numCalls = 0;
+    int numDrawn = 0;
+    setBatchDrawFunction([&](const double* xs, const double* ys, const Color* colors, int count) {
+        numCalls++;
+        for (int i = 0; i < count; i++) {
+            EXPECT_EQUAL(xs[i], numDrawn);
+            EXPECT_EQUAL(ys[i], 2 * numDrawn);
+            EXPECT_EQUAL(colors[i], Color::GREEN);
+            numDrawn++;
+        }
+    });
+    system.drawParticles();
+    setBatchDrawFunction(nullptr);
+
+    EXPECT_EQUAL(numCalls, 1);
+    EXPECT_EQUAL(numDrawn, 5);
+
+    /* With the batch function gone, drawing goes one particle at a time. */
+    ParticleCatcher catcher;
+    system.drawParticles();
+    EXPECT_EQUAL(catcher.numDrawn(), 5);
+}
+
+STUDENT_TEST("particles of different types are drawn in the order chosen") {
+    ParticleSystem system;
+
+    /* Alternate streamers and ballistic particles. */
+    for (int i = 0; i < 6; i++) {
+        Particle particle;
+        particle.x = i;
+        particle.type = (i % 2 == 0) ? ParticleType::STREAMER : ParticleType::BALLISTIC;
+        system.add(particle);
+    }
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 3);
+    EXPECT_EQUAL(system.bucket(ParticleType::BALLISTIC).size(), 3);
+
+    /* By default, they come back in the order they were added. */
+    ParticleCatcher catcher;
+    system.drawParticles();
+    EXPECT_EQUAL(catcher.numDrawn(), 6);
+    for (int i = 0; i < 6; i++) {
+        EXPECT_EQUAL(catcher[i].x, i);
+    }
+
+    /* By type, all the streamers come first. */
+    catcher.reset();
+    system.setDrawOrder(DrawOrder::BY_TYPE);
+    system.drawParticles();
+    EXPECT_EQUAL(catcher.numDrawn(), 6);
+    Vector<double> expected = { 0, 2, 4, 1, 3, 5 };
+    for (int i = 0; i < 6; i++) {
+        EXPECT_EQUAL(catcher[i].x, expected[i]);
+    }
+}
+
+STUDENT_TEST("firework streamers don't move until the next tick") {
+    ParticleSystem system;
+
+    Particle firework;
+    firework.type = ParticleType::FIREWORK;
+    firework.lifetime = 0;
+    firework.x = 100;
+    firework.y = 100;
+    firework.dy = 1;
+    system.add(firework);
+
+    /* The firework moves to (100, 101) and explodes there. */
+    system.moveParticles();
+
+    const ParticleStore& streamers = system.bucket(ParticleType::STREAMER);
+    EXPECT_EQUAL(streamers.size(), 50);
+    for (int i = 0; i < streamers.size(); i++) {
+        EXPECT_EQUAL(streamers.x[i], 100);
+        EXPECT_EQUAL(streamers.y[i], 101);
+    }
 }
 
+STUDENT_TEST("addAll adds valid particles in order") {
+    ParticleSystem system;
 
-/*
- * The destructor is responsible for cleaning up any resources
- * used by this instance of the ParticleSystem class. The
- * memory that was allocated for the ParticleSystem is deleted here.
- */
-ParticleSystem::~ParticleSystem() {
-    while (_head != nullptr) {
-        ParticleCell* temp =_head -> next;
-        delete[] _head;
-        _head = temp;
+    Vector<Particle> particles;
+    for (int i = 0; i < 10; i++) {
+        Particle particle;
+        particle.x = (i == 4) ? -1 : i; // One is out of bounds
+        particle.type = (i % 3 == 0) ? ParticleType::BALLISTIC : ParticleType::STREAMER;
+        particles += particle;
+    }
+    system.addAll(particles);
+    EXPECT_EQUAL(system.numParticles(), 9);
+
+    ParticleCatcher catcher;
+    system.drawParticles();
+    EXPECT_EQUAL(catcher.numDrawn(), 9);
+    Vector<double> expected = { 0, 1, 2, 3, 5, 6, 7, 8, 9 };
+    for (int i = 0; i < 9; i++) {
+        EXPECT_EQUAL(catcher[i].x, expected[i]);
     }
 }
 
+STUDENT_TEST("emit writes a batch of particles and drops invalid ones") {
+    ParticleSystem system;
 
+    /* Every fifth particle has a negative lifetime. */
+    int numMade = 0;
+    system.emit(100, ParticleType::BALLISTIC, [&](Particle& particle) {
+        particle.x = numMade;
+        particle.y = 10;
+        particle.lifetime = (numMade % 5 == 0) ? -1 : 10;
+        numMade++;
+    });
 
-/*
- * tracks number of particles in Particle System
- */
-int ParticleSystem::numParticles() const {
-    return _count;
+    EXPECT_EQUAL(numMade, 100);
+    EXPECT_EQUAL(system.numParticles(), 80);
+
+    const ParticleStore& ballistic = system.bucket(ParticleType::BALLISTIC);
+    EXPECT_EQUAL(ballistic.size(), 80);
+    for (int i = 0; i < ballistic.size(); i++) {
+        EXPECT_NOT_EQUAL(int(ballistic.x[i]) % 5, 0);
+        EXPECT_EQUAL(ballistic.type[i], ParticleType::BALLISTIC);
+    }
 }
 
+STUDENT_TEST("emitting or adding no particles, or fewer than none, changes nothing") {
+    ParticleSystem system;
+    system.emit(10, ParticleType::BALLISTIC, [&](Particle& particle) {
+        particle.x = 10;
+        particle.y = 10;
+        particle.lifetime = 5;
+    });
 
-/*
- * add takes in a Particle parameter called particle. The function adds
- * a particle to the back of the doubly-linked list. It does not return
- * anything as it is a void function.
- */
-void ParticleSystem::add(Particle particle) {
-    // checks if the particle adding is valid
-    if (particle.lifetime < 0 || particle.x < 0 || particle.x >= SCENE_WIDTH || particle.y < 0 || particle.y >= SCENE_HEIGHT) {
-        return;
+    int numMade = 0;
+    auto generate = [&](Particle&) {
+        numMade++;
+    };
+    system.emit(0, ParticleType::BALLISTIC, generate);
+    system.emit(-4, ParticleType::BALLISTIC, generate);
+    system.addAll(nullptr, -4);
+    EXPECT_EQUAL(numMade, 0);
+    EXPECT_EQUAL(system.numParticles(), 10);
+    EXPECT_EQUAL(system._numAdded, 10);
+
+    /* The particles that were there are still checked and removed on time. */
+    for (int tick = 0; tick < 6; tick++) {
+        EXPECT_EQUAL(system.numParticles(), 10);
+        system.moveParticles();
+    }
+    EXPECT_EQUAL(system.numParticles(), 0);
+}
+
+STUDENT_TEST("systems with the same seed explode fireworks the same way") {
+    ParticleSystem one, two;
+    one.seed(137);
+    two.seed(137);
+
+    for (int i = 0; i < 10; i++) {
+        Particle firework;
+        firework.type = ParticleType::FIREWORK;
+        firework.lifetime = i % 3;
+        firework.x = 100 + 10 * i;
+        firework.y = 300;
+        one.add(firework);
+        two.add(firework);
     }
-    _count++;
-    ParticleCell* cPtr = new ParticleCell;
-    cPtr->particle = particle;
-    cPtr->next = nullptr;
-    cPtr->prev = nullptr;
-    if (_tail != nullptr) {
-        _tail->next = cPtr;
-        cPtr->prev = _tail;
+
+    for (int tick = 0; tick < 5; tick++) {
+        one.moveParticles();
+        two.moveParticles();
+
+        const ParticleStore& first = one.bucket(ParticleType::STREAMER);
+        const ParticleStore& second = two.bucket(ParticleType::STREAMER);
+        EXPECT_EQUAL(first.size(), second.size());
+        EXPECT(first.x == second.x);
+        EXPECT(first.dx == second.dx);
+        EXPECT(first.dy == second.dy);
+        EXPECT(first.lifetime == second.lifetime);
+        EXPECT(first.color == second.color);
     }
-    else {
-        _head = cPtr;
+
+    /* Streamers still follow the firework rules. */
+    const ParticleStore& streamers = one.bucket(ParticleType::STREAMER);
+    EXPECT(streamers.size() > 0);
+    for (int i = 0; i < streamers.size(); i++) {
+        EXPECT(streamers.dx[i] >= -3 && streamers.dx[i] <= 3);
+        EXPECT(streamers.lifetime[i] <= 10);
     }
-    _tail = cPtr;
 }
 
+STUDENT_TEST("emitSparse adds one particle per successful trial") {
+    ParticleSystem system;
 
-/*
- * draw particles does not take in any parameters. It goes through each particle
- * and draws it on a given x and y coordinate and color. It does not return anything.
- */
-void ParticleSystem::drawParticles() const {
-    ParticleCell* cur = _head;
-    while (cur != nullptr) {
-        drawParticle(cur->particle.x, cur->particle.y, cur->particle.color);
-        cur = cur -> next;
-    }
+    /* Every column succeeds, but the ones past the edge are dropped. */
+    system.emitSparse(SCENE_WIDTH + 10, 1, ParticleType::BALLISTIC, [&](Particle& particle, int x) {
+        particle.x = x;
+        particle.y = 0;
+        particle.type = ParticleType::STREAMER; // Ignored
+    });
+    EXPECT_EQUAL(system.numParticles(), int(SCENE_WIDTH));
+    EXPECT_EQUAL(system.bucket(ParticleType::BALLISTIC).size(), int(SCENE_WIDTH));
+    EXPECT_EQUAL(system.bucket(ParticleType::BALLISTIC).x[17], 17);
+
+    /* No column succeeds. */
+    int numCalls = 0;
+    system.emitSparse(SCENE_WIDTH, 0, ParticleType::STREAMER, [&](Particle&, int) {
+        numCalls++;
+    });
+    EXPECT_EQUAL(numCalls, 0);
+    EXPECT_EQUAL(system.numParticles(), int(SCENE_WIDTH));
 }
 
+STUDENT_TEST("particles are kept inside the bounds the system is given") {
+    ParticleSystem system;
+    system.setBounds(ParticleBounds::rectangle(100, 100, 50, 50));
 
-/*
- * Helper function moveValid takes in a ParticleCell parameter called particleCell. It checks each
- * Particle Cell in the head location, tail location, or in the middle and then deletes
- * the particleCell if it is not valid. Does not return anything.
- *
- */
-void ParticleSystem::notValidRewire(ParticleCell* particleCell) {
-    ParticleCell* nextt = particleCell->next;
-    ParticleCell* prev = particleCell->prev;
-    // if it is a head, head is now the next cell of cur
-    if (particleCell == _head) {
-        _head = nextt;
-    }
-    else {
-        // if not head, then the previous cell points to next of the cur cell
-        prev->next = nextt;
-    }
-    // if it is tail, tail is now previous of cur
-    if (particleCell == _tail) {
-        _tail = prev;
-    }
-    else {
-        // if not tail, then next cell points to previous of cur cell
-        nextt->prev = prev;
+    Particle particle;
+    particle.x = 10;
+    particle.y = 120;
+    system.add(particle); // Outside the box
+
+    particle.x = 120;
+    particle.dx = 20;
+    system.add(particle); // Leaves on the second move
+
+    particle.dx = 0;
+    system.add(particle); // Stays put
+    EXPECT_EQUAL(system.numParticles(), 2);
+
+    system.moveParticles();
+    EXPECT_EQUAL(system.numParticles(), 2);
+    system.moveParticles();
+    EXPECT_EQUAL(system.numParticles(), 1);
+
+    /* With y open, particles can go as far up or down as they like. */
+    system.setBounds(ParticleBounds().withOpenY());
+    particle.x = 400;
+    particle.y = 10;
+    particle.dy = -100;
+    system.add(particle);
+    for (int i = 0; i < 10; i++) {
+        system.moveParticles();
     }
-    delete particleCell;
-    _count--;
+    EXPECT_EQUAL(system.numParticles(), 2);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).y[1], -990);
+
+    /* With no bounds, particles anywhere can be added. */
+    system.setBounds(ParticleBounds::unbounded());
+    particle.x = -5000;
+    system.add(particle);
+    EXPECT_EQUAL(system.numParticles(), 3);
 }
 
+STUDENT_TEST("scheduled checks remove the same particles as checking every move") {
+    ParticleBounds scene;
+    for (ParticleBounds bounds: { scene, scene.withOpenY(), ParticleBounds::rectangle(50, 50, 500, 300) }) {
+        /* A force that changes nothing still has every particle checked on
+         * every move.
+         */
+        ParticleSystem scheduled, everyMove;
+        everyMove.addForce(Force::constant(0, 0));
+        EXPECT(scheduled.schedulingChecks());
+        EXPECT(!everyMove.schedulingChecks());
+        scheduled.setBounds(bounds);
+        everyMove.setBounds(bounds);
+        scheduled.seed(2024);
+        everyMove.seed(2024);
+
+        for (int tick = 0; tick < 300; tick++) {
+            /* A few new particles each tick, including ones that live
+             * forever and ones whose velocities are whole numbers.
+             */
+            for (int i = 0; i < 20; i++) {
+                Particle particle;
+                particle.x = randomReal(0, SCENE_WIDTH);
+                particle.y = randomReal(0, SCENE_HEIGHT);
+                particle.dx = randomChance(0.2) ? 0 : randomReal(-8, 8);
+                particle.dy = randomChance(0.5) ? randomInteger(-20, 5) : randomReal(-20, 5);
+                particle.lifetime = randomChance(0.5) ? INT_MAX : randomInteger(0, 60);
+                particle.type = ParticleType(randomInteger(0, 2));
+                scheduled.add(particle);
+                everyMove.add(particle);
+            }
 
-/*
- * Helper function fireworks Create takes in parameters ParticleCell and Color.
- * creates a new Particle and adds the rules of a firework type and adds that to the
- * particle list. It does not return anything
- */
-void ParticleSystem::fireworkCreate(ParticleCell* cur, Color color) {
-    Particle particleNew;
-    particleNew.color = color;
-    particleNew.x = cur -> particle.x;
-    particleNew.y = cur -> particle.y;
-    particleNew.dx = randomInteger(-3, 3);
-    particleNew.dy = randomInteger(-3, 3);
-    particleNew.lifetime = randomInteger(2, 10);
-    particleNew.type = ParticleType::STREAMER;
-    add(particleNew);
+            scheduled.moveParticles();
+            everyMove.moveParticles();
+
+            EXPECT_EQUAL(scheduled.numParticles(), everyMove.numParticles());
+            for (int type = 0; type < ParticleSystem::kNumTypes; type++) {
+                EXPECT(scheduled._buckets[type].serial == everyMove._buckets[type].serial);
+                EXPECT(scheduled._buckets[type].x == everyMove._buckets[type].x);
+                EXPECT(scheduled._buckets[type].y == everyMove._buckets[type].y);
+                EXPECT(scheduled._buckets[type].color == everyMove._buckets[type].color);
+            }
+        }
+    }
 }
 
+STUDENT_TEST("lazy motion puts particles in the same places") {
+    ParticleSystem eager, lazy;
+    lazy.setMotion(Motion::LAZY);
+    eager.seed(7);
+    lazy.seed(7);
+
+    int numDrawn = 0;
+    vector<double> drawnX, drawnY;
+    setBatchDrawFunction([&](const double* xs, const double* ys, const Color*, int count) {
+        numDrawn = count;
+        drawnX.assign(xs, xs + count);
+        drawnY.assign(ys, ys + count);
+    });
 
-/*
- * Helper function streamer takes in a parameter ParticleCell.
- * This function follows the rules of particle type streamer.
- */
-void ParticleSystem::streamerFunction(ParticleCell* cur) {
-    cur->particle.x += cur->particle.dx;
-    cur->particle.y += cur->particle.dy;
-    cur->particle.lifetime--;
+    for (int tick = 0; tick < 100; tick++) {
+        for (int i = 0; i < 10; i++) {
+            Particle particle;
+            particle.x = randomInteger(0, SCENE_WIDTH - 1);
+            particle.y = randomInteger(0, SCENE_HEIGHT - 1);
+            particle.dx = randomInteger(-8, 8);
+            particle.dy = randomInteger(-20, 5);
+            particle.lifetime = randomChance(0.5) ? INT_MAX : randomInteger(0, 60);
+            particle.type = ParticleType(randomInteger(0, 2));
+            eager.add(particle);
+            lazy.add(particle);
+        }
+
+        eager.moveParticles();
+        lazy.moveParticles();
+        EXPECT_EQUAL(lazy.numParticles(), eager.numParticles());
+
+        /* Whole numbers keep the arithmetic exact. */
+        eager.drawParticles();
+        vector<double> eagerX = drawnX, eagerY = drawnY;
+        lazy.drawParticles();
+        EXPECT(drawnX == eagerX);
+        EXPECT(drawnY == eagerY);
+    }
+    EXPECT(numDrawn > 0);
+
+    /* Switching back stores the current positions. */
+    lazy.setMotion(Motion::EAGER);
+    for (int type = 0; type < ParticleSystem::kNumTypes; type++) {
+        EXPECT(lazy._buckets[type].x == eager._buckets[type].x);
+        EXPECT(lazy._buckets[type].y == eager._buckets[type].y);
+        EXPECT(lazy._buckets[type].dy == eager._buckets[type].dy);
+        EXPECT(lazy._buckets[type].lifetime == eager._buckets[type].lifetime);
+    }
+    setBatchDrawFunction(nullptr);
 }
 
+STUDENT_TEST("lazy motion keeps up with eager motion when settings change partway") {
+    ParticleSystem eager, lazy;
+    lazy.setMotion(Motion::LAZY);
+    eager.seed(8);
+    lazy.seed(8);
 
-/*
- * Function moveParticles takes in no parameters. This function goes through each particle in the particlesystem
- * and checks for each particle type and performs specific instructions for each type. It then checks if each particle
- * is valid in move and if not, it rewires the pointers, and then goes onto the next particle in the system.
- */
-void ParticleSystem::moveParticles() {
-    ParticleCell* cur = _head;
-    while (cur != nullptr) {
-        if (cur -> particle.type == ParticleType::STREAMER || cur -> particle.type == ParticleType::BALLISTIC) {
-            streamerFunction(cur);
-            if (cur -> particle.type == ParticleType::BALLISTIC) {
-                cur -> particle.dy++;
+    vector<double> drawnX, drawnY;
+    setBatchDrawFunction([&](const double* xs, const double* ys, const Color*, int count) {
+        drawnX.assign(xs, xs + count);
+        drawnY.assign(ys, ys + count);
+    });
+
+    for (int tick = 0; tick < 120; tick++) {
+        if (tick < 40) {
+            for (int i = 0; i < 10; i++) {
+                Particle particle;
+                particle.x = randomInteger(0, SCENE_WIDTH - 1);
+                particle.y = randomInteger(0, SCENE_HEIGHT - 1);
+                particle.dx = randomInteger(-8, 8);
+                particle.dy = randomInteger(-20, 5);
+                particle.lifetime = randomChance(0.5) ? INT_MAX : randomInteger(0, 60);
+                particle.type = ParticleType(randomInteger(0, 2));
+                eager.add(particle);
+                lazy.add(particle);
             }
         }
-        else if (cur -> particle.type == ParticleType::FIREWORK) {
-            streamerFunction(cur);
-            cur ->particle.dy++;
-            if (cur -> particle.lifetime < 0) {
-                Color color = Color::random();
-                // creates 50 new particles of the same color
-                for (int i = 0; i < 50; i++) {
-                    fireworkCreate(cur, color);
-                }
-                ParticleCell* next = cur->next;
-                notValidRewire(cur);
-                cur = next;
+
+        /* Each of these reschedules every check while staying lazy. The
+         * removal policy only matters to the eager system, so it's only
+         * switched back and forth on the lazy one.
+         */
+        if (tick % 10 == 5) {
+            switch (tick / 10 % 4) {
+            case 0:
+                eager.setBounds(ParticleBounds());
+                lazy.setBounds(ParticleBounds());
+                break;
+            case 1:
+                lazy.setRemovalPolicy(RemovalPolicy::UNSTABLE);
+                lazy.setRemovalPolicy(RemovalPolicy::STABLE);
+                break;
+            case 2:
+                eager.clearColliders();
+                lazy.clearColliders();
+                break;
+            case 3:
+                eager.clearForces();
+                lazy.clearForces();
+                break;
             }
         }
-        // checks the rules if the particle should be removed: lifetime and bounds
-        if (cur->particle.lifetime < 0 || cur->particle.x < 0 || cur->particle.x >= SCENE_WIDTH || cur->particle.y < 0 || cur->particle.y >= SCENE_HEIGHT) {
-            // moves onto the next particle of current particle
-            ParticleCell* nextt = cur->next;
-            notValidRewire(cur);
-            cur = nextt;
-        }
-        else {
-            // moves onto the next current particle
-            cur = cur->next;
-        }
+
+        eager.moveParticles();
+        lazy.moveParticles();
+        EXPECT_EQUAL(lazy.numParticles(), eager.numParticles());
+
+        eager.drawParticles();
+        vector<double> eagerX = drawnX, eagerY = drawnY;
+        lazy.drawParticles();
+        EXPECT(drawnX == eagerX);
+        EXPECT(drawnY == eagerY);
     }
+    setBatchDrawFunction(nullptr);
 }
 
-/* * * * * Test Cases Below This Point * * * * */
-
-STUDENT_TEST("ignores adding particles outside boundaries") {
+#ifdef PARTICLE_STATS
+STUDENT_TEST("stats count what happens to particles on each tick") {
     ParticleSystem system;
+    system.seed(106);
 
+    /* Two streamers that die of old age, one that leaves the scene, one
+     * that stays, and a firework that explodes.
+     */
     Particle particle;
-    particle.x = -1;
+    particle.x = 10;
     particle.y = 10;
-    particle.lifetime = 5;
+    particle.lifetime = 0;
+    system.add(particle);
+    system.add(particle);
 
+    particle.x = 0;
+    particle.dx = -1;
+    particle.lifetime = 10;
     system.add(particle);
 
-    EXPECT_EQUAL(system.numParticles(), 0);
+    particle.dx = 0;
+    system.add(particle);
+
+    particle.type = ParticleType::FIREWORK;
+    particle.lifetime = 0;
+    system.add(particle);
 
-    EXPECT_EQUAL(system._head, nullptr);
-    EXPECT_EQUAL(system._tail, nullptr);
+    system.moveParticles();
+    TickStats tick = system.stats().tick(0);
+    EXPECT_EQUAL(system.stats().numTicks(), 1);
+    EXPECT_EQUAL(tick.moved, 5);
+    EXPECT_EQUAL(tick.expired, 3);
+    EXPECT_EQUAL(tick.exploded, 1);
+    EXPECT_EQUAL(tick.culled, 1);
+    EXPECT_EQUAL(tick.spawned, 50);
+    EXPECT(tick.moveSeconds >= 0);
+    EXPECT(tick.bytes > 0);
+    EXPECT_EQUAL(system.stats().peakBytes(), tick.bytes);
+
+    system.drawParticles();
+    EXPECT(system.stats().tick(0).drawSeconds >= 0);
+
+    system.moveParticles();
+    EXPECT_EQUAL(system.stats().numTicks(), 2);
+    EXPECT_EQUAL(system.stats().tick(0).moved, 51);
+}
+#else
+STUDENT_TEST("stats stay empty when they aren't being collected") {
+    ParticleSystem system;
+    Particle particle;
+    system.add(particle);
+    system.moveParticles();
+    system.drawParticles();
+    EXPECT_EQUAL(system.stats().numTicks(), 0);
+    EXPECT_EQUAL(system.stats().peakBytes(), 0);
 }
+#endif
 
-STUDENT_TEST("adding valid particle to empty system") {
+STUDENT_TEST("forEachNeighbor finds the particles near a point") {
     ParticleSystem system;
+    system.setNeighborCellSize(10);
 
-    Particle particle;
-    particle.x = 10;
-    particle.y = 20;
-    particle.lifetime = 5;
+    /* A row of particles of every type, 5 pixels apart. */
+    for (int i = 0; i < 30; i++) {
+        Particle particle;
+        particle.x = 100 + 5 * i;
+        particle.y = 100;
+        particle.dx = 1;
+        particle.lifetime = 100;
+        particle.type = ParticleType(i % 3);
+        system.add(particle);
+    }
+
+    Vector<double> found;
+    system.forEachNeighbor(150, 100, 12, [&](const Particle& particle) {
+        found += particle.x;
+    });
+    sort(found.begin(), found.end());
+    EXPECT_EQUAL(found, { 140, 145, 150, 155, 160 });
+
+    /* After moving, the grid is rebuilt from the new positions. */
+    system.moveParticles();
+    found.clear();
+    system.forEachNeighbor(150, 100, 3, [&](const Particle& particle) {
+        found += particle.x;
+        EXPECT_EQUAL(particle.dx, 1);
+    });
+    EXPECT_EQUAL(found, { 151 });
+}
+
+STUDENT_TEST("interactions push particles using where their neighbors were") {
+    ParticleSystem system;
+    system.setMotion(Motion::LAZY);
 
+    /* Each particle is pulled one pixel per move toward each neighbor. */
+    system.setInteraction(20, [](const InteractionParticles& particles, int particle, int neighbor) {
+        Push push;
+        push.dx = particles.x[neighbor] > particles.x[particle] ? 1 : -1;
+        return push;
+    });
+
+    Particle particle;
+    particle.y = 100;
+    particle.lifetime = 100;
+    particle.x = 100;
+    system.add(particle);
+    particle.x = 110;
+    system.add(particle);
+    particle.x = 200; // Too far away to feel anything
     system.add(particle);
 
-    EXPECT_EQUAL(system.numParticles(), 1);
+    system.moveParticles();
+    const ParticleStore& streamers = system._buckets[int(ParticleType::STREAMER)];
+    EXPECT_EQUAL(streamers.dx, { 1, -1, 0 });
+    EXPECT_EQUAL(streamers.x,  { 101, 109, 200 });
 
-    EXPECT_NOT_EQUAL(system._head, nullptr);
-    EXPECT_EQUAL(system._head, system._tail);
+    /* Lazy motion can't follow an interaction, and asking for it changes
+     * nothing.
+     */
+    EXPECT_ERROR(system.setMotion(Motion::LAZY));
+    EXPECT(system._motion == Motion::EAGER);
+    system.moveParticles();
+    EXPECT_EQUAL(streamers.dx, { 2, -2, 0 });
 
-    EXPECT_EQUAL(system._head->particle.x, 10);
-    EXPECT_EQUAL(system._head->particle.y, 20);
-    EXPECT_EQUAL(system._head->particle.lifetime, 5);
+    /* Once the interaction is gone, lazy motion is fine. */
+    system.setInteraction(20, nullptr);
+    system.setMotion(Motion::LAZY);
+    EXPECT(system._motion == Motion::LAZY);
 }
 
-STUDENT_TEST("tests the streamer particles have the same color") {
+STUDENT_TEST("interactions see the velocities and types of both particles") {
+    ParticleSystem system;
+
+    /* Fireworks push streamers along at their own speed. */
+    system.setInteraction(20, [](const InteractionParticles& particles, int particle, int neighbor) {
+        Push push;
+        if (particles.type[particle] == ParticleType::STREAMER &&
+            particles.type[neighbor] == ParticleType::FIREWORK) {
+            push.dx = particles.dx[neighbor];
+            push.dy = particles.dy[neighbor];
+        }
+        return push;
+    });
+
+    Particle particle;
+    particle.x = 100;
+    particle.y = 100;
+    particle.lifetime = 100;
+    system.add(particle);
+    particle.type = ParticleType::FIREWORK;
+    particle.x = 105;
+    particle.dx = 3;
+    particle.dy = -2;
+    system.add(particle);
+
+    system.moveParticles();
+    const ParticleStore& streamers = system._buckets[int(ParticleType::STREAMER)];
+    const ParticleStore& fireworks = system._buckets[int(ParticleType::FIREWORK)];
+    EXPECT_EQUAL(streamers.dx, { 3 });
+    EXPECT_EQUAL(streamers.dy, { -2 });
+    EXPECT_EQUAL(fireworks.dx, { 3 });
+}
+
+STUDENT_TEST("lazy motion is an error with colliders or forces") {
+    ParticleSystem withCollider;
+    withCollider.addCollider(0, 0, 10, 10, CollisionResponse::ABSORB);
+    EXPECT_ERROR(withCollider.setMotion(Motion::LAZY));
+    withCollider.clearColliders();
+    withCollider.setMotion(Motion::LAZY);
+    EXPECT(withCollider._motion == Motion::LAZY);
+
+    ParticleSystem withForce;
+    withForce.addForce(Force::drag(0.1));
+    EXPECT_ERROR(withForce.setMotion(Motion::LAZY));
+    EXPECT(!withForce._forces.isEmpty());
+    withForce.clearForces();
+    withForce.setMotion(Motion::LAZY);
+    EXPECT(withForce._motion == Motion::LAZY);
+}
+
+STUDENT_TEST("colliders bounce, absorb and stop particles") {
     ParticleSystem system;
+    system.addCollider(100, 200, 100, 50, CollisionResponse::BOUNCE, 0.5);
+    system.addCollider(300, 200, 100, 50, CollisionResponse::ABSORB);
+    system.addCollider(500, 200, 100, 50, CollisionResponse::STICK);
 
+    /* One streamer falling onto each rectangle, and a firework that hits the
+     * absorbing one just as its time runs out.
+     */
+    for (double x: { 150, 350, 550 }) {
+        Particle particle;
+        particle.x = x;
+        particle.y = 196;
+        particle.dy = 8;
+        particle.lifetime = 100;
+        system.add(particle);
+    }
     Particle firework;
+    firework.x = 320;
+    firework.y = 196;
+    firework.dy = 7;
+    firework.lifetime = 0;
     firework.type = ParticleType::FIREWORK;
-    firework.lifetime = 2;
-    firework.x = 50;
-    firework.y = 50;
     system.add(firework);
 
     system.moveParticles();
+    EXPECT_EQUAL(system.numParticles(), 2);
+
+    const ParticleStore& streamers = system._buckets[int(ParticleType::STREAMER)];
+    EXPECT_EQUAL(streamers.x,  { 150, 550 });
+    EXPECT_EQUAL(streamers.y,  { 196, 196 });
+    EXPECT_EQUAL(streamers.dy, { -4, 0 });
+
+    /* The stuck particle stays put; the bounced one flies off. */
+    system.moveParticles();
+    EXPECT_EQUAL(streamers.y, { 192, 196 });
+
+    system.clearColliders();
+    EXPECT(system.schedulingChecks());
+}
+
+STUDENT_TEST("fast particles can't pass through thin colliders") {
+    ParticleSystem system;
+    system.setBounds(ParticleBounds().withOpenY());
+    system.addCollider(0, 300, 800, 2, CollisionResponse::BOUNCE);
+    system.addCollider(0, -1000, 800, 2, CollisionResponse::ABSORB); // Above the scene
+
+    /* Starts above the bouncing floor and would end up well below it. */
+    Particle particle;
+    particle.x = 100;
+    particle.y = 290;
+    particle.dy = 50;
+    particle.lifetime = 100;
+    system.add(particle);
+
+    /* Flies up through the absorbing ceiling, high above the scene. */
+    particle.x = 200;
+    particle.y = -990;
+    particle.dy = -40;
+    system.add(particle);
+
+    system.moveParticles();
+    const ParticleStore& streamers = system._buckets[int(ParticleType::STREAMER)];
+    EXPECT_EQUAL(streamers.size(), 1);
+    EXPECT_EQUAL(streamers.x,  { 100 });
+    EXPECT_EQUAL(streamers.y,  { 260 });
+    EXPECT_EQUAL(streamers.dy, { -50 });
+}
+
+STUDENT_TEST("forces change velocities before particles move") {
+    ParticleSystem wind;
+    wind.addForce(Force::constant(1, 0));
+    wind.addForce(Force::constant(0.5, -0.5).only(ParticleType::BALLISTIC));
+
+    Particle particle;
+    particle.x = 100;
+    particle.y = 100;
+    particle.lifetime = 100;
+    wind.add(particle);
+    particle.type = ParticleType::BALLISTIC;
+    wind.add(particle);
+
+    wind.moveParticles();
+    const ParticleStore& streamers = wind._buckets[int(ParticleType::STREAMER)];
+    const ParticleStore& ballistic = wind._buckets[int(ParticleType::BALLISTIC)];
+    EXPECT_EQUAL(streamers.x[0], 101);
+    EXPECT_EQUAL(streamers.y[0], 100);
+    EXPECT_EQUAL(ballistic.x[0], 101.5);
+    EXPECT_EQUAL(ballistic.y[0], 99.5);
+    EXPECT_EQUAL(ballistic.dy[0], 0.5); // Gravity still applies after the move
+
+    /* Forces run on worker threads too, with the same results. */
+    ParticleSystem serial, parallel;
+    parallel.setThreadCount(4);
+    for (ParticleSystem* system: { &serial, &parallel }) {
+        system->addForce(Force::attractor(400, 300, 500));
+        system->addForce(Force::drag(0.1));
+        for (int i = 0; i < 50000; i++) {
+            Particle particle;
+            particle.x = i % 800;
+            particle.y = (i / 800) * 5;
+            particle.lifetime = 20;
+            system->add(particle);
+        }
+    }
+    for (int step = 0; step < 5; step++) {
+        serial.moveParticles();
+        parallel.moveParticles();
+    }
+    EXPECT_EQUAL(serial.numParticles(), parallel.numParticles());
+    EXPECT(serial._buckets[0].x == parallel._buckets[0].x);
+    EXPECT(serial._buckets[0].dy == parallel._buckets[0].dy);
+
+    wind.clearForces();
+    EXPECT(wind.schedulingChecks());
+}
+
+STUDENT_TEST("moveParticles(dt) takes fixed steps and keeps the leftover time") {
+    ParticleSystem system;
+    system.setStepRate(10);
+
+    Particle particle;
+    particle.x = 0;
+    particle.y = 0;
+    particle.dx = 1;
+    particle.lifetime = 1000;
+    system.add(particle);
+
+    EXPECT_EQUAL(system.moveParticles(0.05), 0);
+    EXPECT_EQUAL(system.stepProgress(), 0.5);
+    EXPECT_EQUAL(system.moveParticles(0.05), 1);
+    EXPECT_EQUAL(system.moveParticles(0.3), 3);
+    EXPECT_EQUAL(system._buckets[0].x[0], 4);
+
+    /* Too many steps at once, and the extra time is dropped. */
+    system.setMaxStepsPerCall(5);
+    EXPECT_EQUAL(system.moveParticles(2.0), 5);
+    EXPECT_EQUAL(system.stepProgress(), 0);
+    EXPECT_EQUAL(system._buckets[0].x[0], 9);
+}
+
+STUDENT_TEST("moveParticles(dt) copes with huge times and rejects bad ones") {
+    ParticleSystem system;
+    system.setStepRate(10);
+
+    Particle particle;
+    particle.x = 0;
+    particle.y = 0;
+    particle.dx = 1;
+    particle.lifetime = 1000;
+    system.add(particle);
+
+    /* Far more steps than fit in an int, or even in a double. */
+    EXPECT_EQUAL(system.moveParticles(1e12), 8);
+    EXPECT_EQUAL(system.stepProgress(), 0);
+    EXPECT_EQUAL(system.moveParticles(1e308), 8);
+    EXPECT_EQUAL(system.stepProgress(), 0);
+    EXPECT_EQUAL(system._buckets[0].x[0], 16);
+
+    /* Time running backward doesn't move anything. */
+    EXPECT_EQUAL(system.moveParticles(-5), 0);
+    EXPECT_EQUAL(system.stepProgress(), 0);
+
+    /* Times and settings that aren't numbers, or are negative, are errors
+     * and leave the system as it was.
+     */
+    EXPECT_ERROR(system.moveParticles(NAN));
+    EXPECT_ERROR(system.moveParticles(INFINITY));
+    EXPECT_ERROR(system.moveParticles(-INFINITY));
+    EXPECT_ERROR(system.setStepRate(NAN));
+    EXPECT_ERROR(system.setStepRate(INFINITY));
+    EXPECT_ERROR(system.setStepRate(-1));
+    EXPECT_ERROR(system.setMaxStepsPerCall(-1));
+    EXPECT_EQUAL(system.stepProgress(), 0);
+    EXPECT_EQUAL(system.moveParticles(0.25), 2);
+    EXPECT_EQUAL(system.stepProgress(), 0.5);
+    EXPECT_EQUAL(system._buckets[0].x[0], 18);
+
+    /* A step rate of zero pauses the system. */
+    system.setStepRate(0);
+    EXPECT_EQUAL(system.moveParticles(100), 0);
+}
+
+STUDENT_TEST("moving several steps at once matches moving one step at a time") {
+    ParticleSystem stepped, batched;
+    stepped.seed(106);
+    batched.seed(106);
+    batched.setStepRate(1);
+    batched.setMaxStepsPerCall(100);
+
+    ParticleRandom random(137);
+    for (int tick = 0; tick < 20; tick++) {
+        /* Long-lived particles, which leave long stretches of quiet moves, and
+         * the occasional firework.
+         */
+        for (int i = 0; i < 20; i++) {
+            Particle particle;
+            particle.x = random.integer(0, SCENE_WIDTH - 1);
+            particle.y = random.integer(0, SCENE_HEIGHT - 1);
+            particle.dx = random.real(-0.1, 0.1);
+            particle.dy = random.real(-0.1, 0.1);
+            particle.lifetime = random.chance(0.9) ? INT_MAX : random.integer(0, 100);
+            particle.type = random.chance(0.02) ? ParticleType::FIREWORK : ParticleType::STREAMER;
+            stepped.add(particle);
+            batched.add(particle);
+        }
 
-    ParticleSystem::ParticleCell* particleCell = system._head;
-    Color streamerColor = particleCell->particle.color;
+        int numSteps = random.integer(1, 40);
+        for (int step = 0; step < numSteps; step++) {
+            stepped.moveParticles();
+        }
+        EXPECT_EQUAL(batched.moveParticles(numSteps), numSteps);
+        EXPECT_EQUAL(batched.numParticles(), stepped.numParticles());
+    }
 
-    while (particleCell != nullptr) {
-        EXPECT_EQUAL(particleCell->particle.color, streamerColor);
-        particleCell = particleCell->next;
+    for (int type = 0; type < ParticleSystem::kNumTypes; type++) {
+        EXPECT(batched._buckets[type].x == stepped._buckets[type].x);
+        EXPECT(batched._buckets[type].y == stepped._buckets[type].y);
+        EXPECT(batched._buckets[type].dy == stepped._buckets[type].dy);
+        EXPECT(batched._buckets[type].color == stepped._buckets[type].color);
+        EXPECT(batched._buckets[type].lifetime == stepped._buckets[type].lifetime);
     }
+    EXPECT_EQUAL(batched._numMoves, stepped._numMoves);
 }
 
+STUDENT_TEST("stable removal only touches the particles after the first one removed") {
+    ParticleSystem system;
+    system.setMotion(Motion::LAZY);
+    for (int i = 0; i < 100; i++) {
+        Particle particle;
+        particle.x = i;
+        particle.y = 100;
+        particle.lifetime = i == 90 ? 5 : INT_MAX;
+        system.add(particle);
+    }
+
+    /* Ticks where nothing is removed leave the store as it was. */
+    ParticleStore& store = system._buckets[int(ParticleType::STREAMER)];
+    vector<double> x = store.x;
+    vector<long long> serial = store.serial;
+    for (int tick = 0; tick < 5; tick++) {
+        system.moveParticles();
+        EXPECT_EQUAL(system._numChunks, 1);
+        EXPECT(system._chunks[0].kills.empty());
+        EXPECT_EQUAL(system.removeStable(store), 0);
+    }
+    EXPECT(store.x == x);
+    EXPECT(store.serial == serial);
+
+    /* Particle 90 dies on the next tick, and only the nine after it slide
+     * down.
+     */
+    system.moveParticles();
+    EXPECT_EQUAL(system.numParticles(), 99);
+    EXPECT_EQUAL(store.x[89], 89);
+    EXPECT_EQUAL(store.x[90], 91);
+
+    system._chunks[0].kills = { 50, 97 };
+    EXPECT_EQUAL(system.removeStable(store), 47);
+    EXPECT_EQUAL(system.numParticles(), 97);
+    EXPECT_EQUAL(store.x[49], 49);
+    EXPECT_EQUAL(store.x[50], 51);
+    EXPECT_EQUAL(store.x[96], 99);
+}
 
 /* * * * * Provided Tests Below This Point * * * * */
 
 PROVIDED_TEST("Milestone 1: Constructor creates an empty particle system.") {
     ParticleSystem system;
-    EXPECT_EQUAL(system._head, nullptr);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 0);
 }
 
 PROVIDED_TEST("Milestone 1: Empty system has no particles.") {
@@ -269,19 +2206,19 @@ PROVIDED_TEST("Milestone 1: Can add a single particle.") {
     /* Should have one particle. */
     EXPECT_EQUAL(system.numParticles(), 1);
 
-    /* Invasively check to make sure the _head pointer isn't null,
+    /* Invasively check to make sure the store isn't empty,
      * since it needs to hold our particle.
      */
-    EXPECT_NOT_EQUAL(system._head, nullptr);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 1);
 
     /* Make sure the particle's x, y, and color are copied over. */
-    EXPECT_EQUAL(system._head->particle.x, particle.x);
-    EXPECT_EQUAL(system._head->particle.y, particle.y);
-    EXPECT_EQUAL(system._head->particle.color, particle.color);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x[0], particle.x);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).y[0], particle.y);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).color[0], particle.color);
 
-    /* Make sure the list is wired correctly. */
-    EXPECT_EQUAL(system._head->prev, nullptr);
-    EXPECT_EQUAL(system._head->next, nullptr);
+    /* Make sure the store holds exactly one particle in every array. */
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).y.size()), 1);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).color.size()), 1);
 }
 
 PROVIDED_TEST("Milestone 1: Can add two particles.") {
@@ -299,18 +2236,12 @@ PROVIDED_TEST("Milestone 1: Can add two particles.") {
     /* Make sure we see two particles. */
     EXPECT_EQUAL(system.numParticles(), 2);
 
-    /* Make sure the list has two items in it. */
-    EXPECT_NOT_EQUAL(system._head, nullptr);
-    EXPECT_NOT_EQUAL(system._head->next, nullptr);
-    EXPECT_EQUAL(system._head->next->next, nullptr);
-
-    /* Make sure previous pointers work correctly. */
-    EXPECT_EQUAL(system._head->prev, nullptr);
-    EXPECT_EQUAL(system._head->next->prev, system._head);
+    /* Make sure the store has two items in it. */
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 2);
 
     /* Make sure the particles are in the right order. */
-    EXPECT_EQUAL(system._head->particle.x, 1);
-    EXPECT_EQUAL(system._head->next->particle.x, 2);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x[0], 1);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x[1], 2);
 }
 
 PROVIDED_TEST("Milestone 1: Can add multiple particles.") {
@@ -328,24 +2259,13 @@ PROVIDED_TEST("Milestone 1: Can add multiple particles.") {
 
     /* Confirm they're there and in the right order. */
     int numSeen = 0;
-    ParticleSystem::ParticleCell* prev = nullptr;
-    ParticleSystem::ParticleCell* curr = system._head;
 
-    /* Walk the list checking particles. */
-    while (curr != nullptr) {
+    /* Walk the store checking particles. */
+    for (int i = 0; i < system.bucket(ParticleType::STREAMER).size(); i++) {
         /* x coordinate tracks which particle this is, so this is a way of
          * checking whether we've got the particles in the right order.
          */
-        EXPECT_EQUAL(curr->particle.x, numSeen);
-
-        /* Check the list wiring - we should point back to the cell before us,
-         * or to nullptr if there are no cells here.
-         */
-        EXPECT_EQUAL(curr->prev, prev);
-
-        /* Advance forward. */
-        prev = curr;
-        curr = curr->next;
+        EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x[i], numSeen);
         numSeen++;
     }
 
@@ -449,32 +2369,32 @@ PROVIDED_TEST("Milestone 3: Can move a single particle.") {
     EXPECT_EQUAL(system.numParticles(), 1);
 
     /* Confirm we have all the right information stored. */
-    EXPECT_NOT_EQUAL(system._head, nullptr);
-    EXPECT_EQUAL(system._head->particle.x,     particle.x);
-    EXPECT_EQUAL(system._head->particle.y,     particle.y);
-    EXPECT_EQUAL(system._head->particle.color, particle.color);
-    EXPECT_EQUAL(system._head->particle.dx,    particle.dx);
-    EXPECT_EQUAL(system._head->particle.dy,    particle.dy);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 1);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x[0],     particle.x);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).y[0],     particle.y);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).color[0], particle.color);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).dx[0],    particle.dx);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).dy[0],    particle.dy);
 
     /* Move the particle. */
     system.moveParticles();
 
     /* The particle should be in a new spot with the same initial velocity. */
-    EXPECT_EQUAL(system._head->particle.x,     particle.x + particle.dx);
-    EXPECT_EQUAL(system._head->particle.y,     particle.y + particle.dy);
-    EXPECT_EQUAL(system._head->particle.color, particle.color);
-    EXPECT_EQUAL(system._head->particle.dx,    particle.dx);
-    EXPECT_EQUAL(system._head->particle.dy,    particle.dy);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x[0],     particle.x + particle.dx);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).y[0],     particle.y + particle.dy);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).color[0], particle.color);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).dx[0],    particle.dx);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).dy[0],    particle.dy);
 
     /* Move the particle again. */
     system.moveParticles();
 
     /* The particle should be in a new spot with the same initial velocity. */
-    EXPECT_EQUAL(system._head->particle.x,     particle.x + 2 * particle.dx);
-    EXPECT_EQUAL(system._head->particle.y,     particle.y + 2 * particle.dy);
-    EXPECT_EQUAL(system._head->particle.color, particle.color);
-    EXPECT_EQUAL(system._head->particle.dx,    particle.dx);
-    EXPECT_EQUAL(system._head->particle.dy,    particle.dy);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x[0],     particle.x + 2 * particle.dx);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).y[0],     particle.y + 2 * particle.dy);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).color[0], particle.color);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).dx[0],    particle.dx);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).dy[0],    particle.dy);
 }
 
 PROVIDED_TEST("Milestone 3: Can move multiple particles with different velocities.") {
@@ -538,11 +2458,11 @@ PROVIDED_TEST("Milestone 4: Don't add invalid particles to the list.") {
 
     /* Add the particle; confirm it's there. */
     system.add(good);
-    EXPECT_NOT_EQUAL(system._head, nullptr);
-    EXPECT_EQUAL(system._head->particle.x,        good.x);
-    EXPECT_EQUAL(system._head->particle.y,        good.y);
-    EXPECT_EQUAL(system._head->particle.color,    good.color);
-    EXPECT_EQUAL(system._head->particle.lifetime, good.lifetime);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 1);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x[0],        good.x);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).y[0],        good.y);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).color[0],    good.color);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).lifetime[0], good.lifetime);
     EXPECT_EQUAL(system.numParticles(), 1);
 
     /* Now make a mix of bad particles that are out of bounds. */
@@ -574,14 +2494,13 @@ PROVIDED_TEST("Milestone 4: Don't add invalid particles to the list.") {
     EXPECT_EQUAL(system.numParticles(), 1);
 
     /* Make sure the first particle is still there and unchanged. */
-    EXPECT_EQUAL(system._head->particle.x,        good.x);
-    EXPECT_EQUAL(system._head->particle.y,        good.y);
-    EXPECT_EQUAL(system._head->particle.color,    good.color);
-    EXPECT_EQUAL(system._head->particle.lifetime, good.lifetime);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).x[0],        good.x);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).y[0],        good.y);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).color[0],    good.color);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).lifetime[0], good.lifetime);
 
-    /* Make sure the list is still valid. */
-    EXPECT_EQUAL(system._head->next, nullptr);
-    EXPECT_EQUAL(system._head->prev, nullptr);
+    /* Make sure the store still holds just that particle. */
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 1);
 }
 
 PROVIDED_TEST("Milestone 4: Particle removed when it leaves the screen.") {
@@ -717,17 +2636,10 @@ PROVIDED_TEST("Milestone 4: All particles move even if first needs to be removed
     EXPECT_EQUAL(catcher[2], { 3, 1, colors[3] });
     EXPECT_EQUAL(catcher[3], { 4, 1, colors[4] });
 
-    /* Check the linked list to make sure the wiring is right. */
-    ParticleSystem::ParticleCell* curr = system._head;
-    ParticleSystem::ParticleCell* prev = nullptr;
-    for (int i = 0; i < 4; i++) {
-        EXPECT_NOT_EQUAL(curr, nullptr);
-        EXPECT_EQUAL(curr->prev, prev);
-
-        prev = curr;
-        curr = curr->next;
-    }
-    EXPECT_EQUAL(curr, nullptr);
+    /* Check the store to make sure every field array was compacted. */
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 4);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).lifetime.size()), 4);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).color.size()), 4);
 }
 
 PROVIDED_TEST("Milestone 4: All particles move even if second needs to be removed.") {
@@ -777,17 +2689,10 @@ PROVIDED_TEST("Milestone 4: All particles move even if second needs to be remove
     EXPECT_EQUAL(catcher[2], { 3, 1, colors[3] });
     EXPECT_EQUAL(catcher[3], { 4, 1, colors[4] });
 
-    /* Check the linked list to make sure the wiring is right. */
-    ParticleSystem::ParticleCell* curr = system._head;
-    ParticleSystem::ParticleCell* prev = nullptr;
-    for (int i = 0; i < 4; i++) {
-        EXPECT_NOT_EQUAL(curr, nullptr);
-        EXPECT_EQUAL(curr->prev, prev);
-
-        prev = curr;
-        curr = curr->next;
-    }
-    EXPECT_EQUAL(curr, nullptr);
+    /* Check the store to make sure every field array was compacted. */
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 4);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).lifetime.size()), 4);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).color.size()), 4);
 }
 
 PROVIDED_TEST("Milestone 4: All particles move even if last needs to be removed.") {
@@ -837,17 +2742,10 @@ PROVIDED_TEST("Milestone 4: All particles move even if last needs to be removed.
     EXPECT_EQUAL(catcher[2], { 2, 1, colors[2] });
     EXPECT_EQUAL(catcher[3], { 3, 1, colors[3] });
 
-    /* Check the linked list to make sure the wiring is right. */
-    ParticleSystem::ParticleCell* curr = system._head;
-    ParticleSystem::ParticleCell* prev = nullptr;
-    for (int i = 0; i < 4; i++) {
-        EXPECT_NOT_EQUAL(curr, nullptr);
-        EXPECT_EQUAL(curr->prev, prev);
-
-        prev = curr;
-        curr = curr->next;
-    }
-    EXPECT_EQUAL(curr, nullptr);
+    /* Check the store to make sure every field array was compacted. */
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 4);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).lifetime.size()), 4);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).color.size()), 4);
 }
 
 PROVIDED_TEST("Milestone 4: All particles move even if second-to-last needs to be removed.") {
@@ -897,17 +2795,10 @@ PROVIDED_TEST("Milestone 4: All particles move even if second-to-last needs to b
     EXPECT_EQUAL(catcher[2], { 2, 1, colors[2] });
     EXPECT_EQUAL(catcher[3], { 4, 1, colors[4] });
 
-    /* Check the linked list to make sure the wiring is right. */
-    ParticleSystem::ParticleCell* curr = system._head;
-    ParticleSystem::ParticleCell* prev = nullptr;
-    for (int i = 0; i < 4; i++) {
-        EXPECT_NOT_EQUAL(curr, nullptr);
-        EXPECT_EQUAL(curr->prev, prev);
-
-        prev = curr;
-        curr = curr->next;
-    }
-    EXPECT_EQUAL(curr, nullptr);
+    /* Check the store to make sure every field array was compacted. */
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 4);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).lifetime.size()), 4);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).color.size()), 4);
 }
 
 PROVIDED_TEST("Milestone 4: All particles move even if first needs to be removed.") {
@@ -957,17 +2848,10 @@ PROVIDED_TEST("Milestone 4: All particles move even if first needs to be removed
     EXPECT_EQUAL(catcher[2], { 3, 1, colors[3] });
     EXPECT_EQUAL(catcher[3], { 4, 1, colors[4] });
 
-    /* Check the linked list to make sure the wiring is right. */
-    ParticleSystem::ParticleCell* curr = system._head;
-    ParticleSystem::ParticleCell* prev = nullptr;
-    for (int i = 0; i < 4; i++) {
-        EXPECT_NOT_EQUAL(curr, nullptr);
-        EXPECT_EQUAL(curr->prev, prev);
-
-        prev = curr;
-        curr = curr->next;
-    }
-    EXPECT_EQUAL(curr, nullptr);
+    /* Check the store to make sure every field array was compacted. */
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 4);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).lifetime.size()), 4);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).color.size()), 4);
 }
 
 PROVIDED_TEST("Milestone 4: All particles move even if many need to be removed.") {
@@ -1017,17 +2901,10 @@ PROVIDED_TEST("Milestone 4: All particles move even if many need to be removed."
     EXPECT_EQUAL(catcher[0], { 1, 1, colors[1] });
     EXPECT_EQUAL(catcher[1], { 3, 1, colors[3] });
 
-    /* Check the linked list to make sure the wiring is right. */
-    ParticleSystem::ParticleCell* curr = system._head;
-    ParticleSystem::ParticleCell* prev = nullptr;
-    for (int i = 0; i < 2; i++) {
-        EXPECT_NOT_EQUAL(curr, nullptr);
-        EXPECT_EQUAL(curr->prev, prev);
-
-        prev = curr;
-        curr = curr->next;
-    }
-    EXPECT_EQUAL(curr, nullptr);
+    /* Check the store to make sure every field array was compacted. */
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 2);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).lifetime.size()), 2);
+    EXPECT_EQUAL(int(system.bucket(ParticleType::STREAMER).color.size()), 2);
 }
 
 PROVIDED_TEST("Milestone 4: After all particles expire, can add new particles.") {
@@ -1201,11 +3078,11 @@ PROVIDED_TEST("Milestone 5: Fireworks explode when timer expires.") {
      * all of which are the same color.
      */
     EXPECT_EQUAL(system.numParticles(), 50);
-    EXPECT_NOT_EQUAL(system._head, nullptr);
+    EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).size(), 50);
 
     /* Color of the first particle. */
-    Color color = system._head->particle.color;
-    for (auto* curr = system._head; curr != nullptr; curr = curr->next) {
-        EXPECT_EQUAL(curr->particle.color, color);
+    Color color = system.bucket(ParticleType::STREAMER).color[0];
+    for (int i = 0; i < system.bucket(ParticleType::STREAMER).size(); i++) {
+        EXPECT_EQUAL(system.bucket(ParticleType::STREAMER).color[i], color);
     }
 }
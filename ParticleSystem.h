@@ -5,15 +5,89 @@
 #pragma once
 
 #include "Particle.h"
+#include "ParticleStore.h"
+#include "ParticleBounds.h"
+#include "ParticleRandom.h"
+#include "ParticleStats.h"
+#include "SpatialGrid.h"
+#include "Colliders.h"
+#include "Forces.h"
 #include "GUI/SimpleTest.h"
 #include "DrawParticle.h"
 #include "GUI/MemoryDiagnostics.h"
+#include "WorkerPool.h"
+#include "TimingWheel.h"
+#include "vector.h"
+#include <functional>
+#include <memory>
+#include <vector>
 
-/* Dimensions of a graphics scene. Particles that move outside the bounding
- * box [0, SCENE_WIDTH) x [0, SCENE_HEIGHT) disappear.
+/* How moveParticles removes dead particles.
+ *
+ *   RemovalPolicy::STABLE:   Survivors are slid down over the removed
+ *                            particles in one pass, so they keep the order
+ *                            they were added in. This is the default.
+ *   RemovalPolicy::UNSTABLE: Each removed particle is replaced by the last
+ *                            particle in the system. Cheaper when lots of
+ *                            particles die in the same tick, but the draw
+ *                            order gets shuffled.
  */
-const double SCENE_WIDTH  = 800;
-const double SCENE_HEIGHT = 600;
+enum class RemovalPolicy {
+    STABLE, UNSTABLE
+};
+
+/* The order drawParticles draws particles in. Particles of each type are
+ * stored separately, so putting them back in one sequence takes some work.
+ *
+ *   DrawOrder::INSERTION: Particles are drawn in the order they were added.
+ *                         This is the default.
+ *   DrawOrder::BY_TYPE:   All streamers, then all ballistic particles, then
+ *                         all fireworks. Within a type, particles are drawn
+ *                         in the order they were added.
+ */
+enum class DrawOrder {
+    INSERTION, BY_TYPE
+};
+
+/* How moveParticles moves particles.
+ *
+ *   Motion::EAGER: Every particle's position is updated on every move. This
+ *                  is the default.
+ *   Motion::LAZY:  Each particle keeps the position, velocity and lifetime
+ *                  it had at some earlier move, and where it is now is
+ *                  worked out in one step when it's drawn or checked for
+ *                  removal. Moving then costs nothing apart from removing
+ *                  particles. Positions can differ from EAGER in the last
+ *                  few bits, since they aren't built up one move at a time.
+ *                  Particles are always removed stably in this mode.
+ */
+enum class Motion {
+    EAGER, LAZY
+};
+
+/* A change to a particle's velocity. */
+struct Push {
+    double dx = 0, dy = 0;
+};
+
+/* The particles an interaction looks at, as arrays: particle i is at
+ * (x[i], y[i]), moving at (dx[i], dy[i]), and has type type[i]. All the
+ * streamers come first, then the ballistic particles, then the fireworks.
+ */
+struct InteractionParticles {
+    const double* x;
+    const double* y;
+    const double* dx;
+    const double* dy;
+    const ParticleType* type;
+};
+
+/* How one particle affects another nearby: given the particles and the
+ * indices of a particle and one of its neighbors, returns the push the
+ * neighbor gives the particle. See ParticleSystem::setInteraction.
+ */
+using Interaction = std::function<Push (const InteractionParticles& particles,
+                                        int particle, int neighbor)>;
 
 /* Type representing a particle system: a collection of particles that can
  * be moved around the screen.
@@ -23,56 +97,405 @@ public:
     /* Creates a new, empty particle system. */
     ParticleSystem();
 
-    /* Cleans up all memory used by the particle system. */
-    ~ParticleSystem();
-
-    /* Adds a new particle to the scene. If the particle is out of bounds or
-     * has a negative lifetime, has no effect. The particle is placed at
-     * the end of the list of particles, and this function runs in time O(1).
+    /* Adds a new particle to the scene. If the particle is out of bounds (see
+     * setBounds) or has a negative lifetime, has no effect. The particle is placed at
+     * the end of the list of particles, and this function runs in amortized
+     * time O(1).
      */
     void add(Particle particle);
 
+    /* Adds a batch of particles, in order, following the same rules as add.
+     * Room for the whole batch is made up front, so this is faster than
+     * adding the particles one at a time. A count of zero or less adds
+     * nothing.
+     */
+    void addAll(const Particle* particles, int count);
+    void addAll(const Vector<Particle>& particles);
+
+    /* Adds 'count' particles of the given type, calling generate(particle)
+     * to fill in each one. Particles are written straight into the system's
+     * storage, and then the whole batch is checked at once; invalid ones are
+     * dropped, as with add. The type field the generator sets is ignored. A
+     * count of zero or less adds nothing.
+     */
+    template <typename Generator> void emit(int count, ParticleType type, Generator generate);
+
+    /* Runs 'numTrials' trials that each succeed with the given probability,
+     * and adds a particle of the given type for each success by calling
+     * generate(particle, trial). This is for emitters spread over a line or
+     * an area, such as one chance per pixel; the cost depends on how many
+     * particles are made rather than how many trials there are (see
+     * ParticleRandom::forEachSuccess). Invalid particles are dropped, as with
+     * add.
+     */
+    template <typename Generator>
+    void emitSparse(int numTrials, double probability, ParticleType type, Generator generate);
+
     /* Returns how many particles are in the particle system. Runs in time
      * O(1).
      */
     int numParticles() const;
 
-    /* Draws all the particles in the system. */
+    /* Makes room for at least the given number of particles of the given
+     * type, so that adding up to that many won't need to allocate any
+     * memory.
+     */
+    void reserve(int numParticles, ParticleType type = ParticleType::STREAMER);
+
+    /* Draws all the particles in the system. They are handed to the renderer
+     * as a single batch (see drawParticleBatch in DrawParticle.h).
+     */
     void drawParticles() const;
 
     /* Moves all particles in the system. This may cause some particles
      * to be removed (if their lifetimes end or the particles move out of
-     * bounds) or added (if firework particles explode).
+     * bounds) or added (if firework particles explode). Particles from an
+     * explosion are added at the end of the tick, so they first move on the
+     * next call.
+     *
+     * With the stable removal policy, the system works out ahead of time
+     * when each particle might need removing and only checks it then, so
+     * most ticks just move the particles.
      */
     void moveParticles();
 
+    /* Advances the system by 'dt' seconds, at a fixed rate of steps per
+     * second (see setStepRate), and returns how many steps were taken. Each
+     * step is one call to moveParticles. Time left over that doesn't make a
+     * whole step is saved for the next call, so the simulation keeps the
+     * same pace whatever the frame rate.
+     *
+     * If the renderer falls behind, several steps are run in one call. When
+     * none of the particles need checking during a run of steps, those
+     * steps are made in one pass over the particles, with each chunk moved
+     * all the steps before going on to the next. The results are the same
+     * as moving one step at a time. At most setMaxStepsPerCall steps are
+     * taken; any time beyond that is dropped, so that a slow frame makes
+     * the simulation lag rather than fall further and further behind.
+     *
+     * A negative dt takes no steps. Reports an error if dt is infinite or
+     * not a number.
+     */
+    int moveParticles(double dt);
+
+    /* Sets how many steps moveParticles(dt) takes per second. The default
+     * is 50, the scenes' usual frame rate. Reports an error if the rate is
+     * negative, infinite or not a number.
+     */
+    void setStepRate(double stepsPerSecond);
+
+    /* Sets the most steps one call to moveParticles(dt) takes. The default
+     * is 8. Reports an error if it's negative.
+     */
+    void setMaxStepsPerCall(int maxSteps);
+
+    /* How far moveParticles(dt) is into the next step, from 0 up to 1.
+     * Useful for drawing things in between steps.
+     */
+    double stepProgress() const;
+
+    /* Chooses how dead particles are removed when moving particles. See the
+     * RemovalPolicy type above for the options.
+     */
+    void setRemovalPolicy(RemovalPolicy policy);
+
+    /* Chooses the order drawParticles draws particles in. See the DrawOrder
+     * type above for the options.
+     */
+    void setDrawOrder(DrawOrder order);
+
+    /* Chooses how particles are moved. See the Motion type above for the
+     * options. Reports an error if asked for Motion::LAZY while there's an
+     * interaction, a collider or a force, since those need particles moved
+     * one step at a time.
+     */
+    void setMotion(Motion motion);
+
+    /* Calls fn(particle) for each particle within 'radius' of (x, y), in no
+     * particular order. Particles are filed in a grid of square cells (see
+     * SpatialGrid.h), so this only looks at particles in the cells the
+     * circle overlaps. The grid is rebuilt, in time O(n), the first time
+     * it's needed after the particles change.
+     */
+    template <typename Function>
+    void forEachNeighbor(double x, double y, double radius, Function fn) const;
+
+    /* Sets the width of the cells forEachNeighbor uses. Cells about as wide
+     * as a typical query radius work best. The default is 16.
+     */
+    void setNeighborCellSize(double cellSize);
+
+    /* Makes particles act on each other. At the start of each move, every
+     * particle gets the sum of the pushes from the particles within 'radius'
+     * of it, computed from where everything was before any pushes are
+     * applied, so the result doesn't depend on the order of the particles.
+     * The pushes change the particles' velocities before they move. This
+     * uses the neighbor grid, with cells 'radius' wide, and takes time
+     * O(n) per move for evenly spread particles. The particles are split
+     * among threads as in setThreadCount.
+     *
+     * Particles need moving one step at a time for this, so setting an
+     * interaction switches to Motion::EAGER, and choosing Motion::LAZY
+     * while there's an interaction is an error. Passing nullptr removes the
+     * interaction.
+     */
+    void setInteraction(double radius, Interaction interaction);
+
+    /* Adds a solid rectangle [x, x + width) x [y, y + height) that particles
+     * run into, with the given response (see Colliders.h). After each move,
+     * a particle that ran into a rectangle on the way, even one it passed
+     * right through, bounces off it, keeping 'bounciness' of its speed; is
+     * removed; or sticks where it was. An absorbed firework doesn't
+     * explode. Only the rectangles near each particle's path are checked,
+     * in a grid over the bounds (see setBounds), so dozens of rectangles
+     * cost little more than one.
+     *
+     * As with interactions, this switches to Motion::EAGER, and choosing
+     * Motion::LAZY while there are rectangles is an error.
+     */
+    void addCollider(double x, double y, double width, double height,
+                     CollisionResponse response, double bounciness = 1);
+
+    /* Removes all the rectangles added with addCollider. */
+    void clearColliders();
+
+    /* Adds a force, such as wind or an attractor, that changes particles'
+     * velocities on every move (see Forces.h). Forces act on whole chunks
+     * of particles at once, just before they move, and on top of gravity.
+     * Constant forces are added together up front, so any number of them
+     * costs one add per particle.
+     *
+     * As with interactions, this switches to Motion::EAGER, and choosing
+     * Motion::LAZY while there are forces is an error.
+     */
+    void addForce(const Force& force);
+
+    /* Removes all the forces added with addForce. */
+    void clearForces();
+
+    /* Sets how many threads moveParticles may use. With more than one
+     * thread, large particle systems are split into fixed-size chunks that
+     * are moved in parallel. Small systems are still moved on the calling
+     * thread, since starting up the workers would cost more than it saves.
+     * The results are the same no matter how many threads are used. The
+     * default is one thread.
+     */
+    void setThreadCount(int numThreads);
+
+    /* Sets the region particles live in. Particles outside it are not added,
+     * and particles that leave it are removed the next time they move.
+     * Particles already in the system are not checked right away. The
+     * default is the scene, [0, SCENE_WIDTH) x [0, SCENE_HEIGHT).
+     */
+    void setBounds(const ParticleBounds& bounds);
+    ParticleBounds bounds() const;
+
+    /* Restarts the system's random number generator, which is used for
+     * firework explosions, from the given seed. Two systems given the same
+     * seed and the same particles behave identically, whatever their thread
+     * counts. Without a call to seed, each system is seeded randomly.
+     */
+    void seed(uint64_t seed);
+
+    /* Returns the system's random number generator, so scenes can create
+     * their particles with it too (see ParticleRandom.h).
+     */
+    ParticleRandom& random();
+
+    /* Returns what happened on recent calls to moveParticles and how long
+     * they and the calls to drawParticles took (see ParticleStats.h). This
+     * stays empty unless the program is built with PARTICLE_STATS defined.
+     */
+    const ParticleStats& stats() const;
 
 private:
-    /* Doubly-linked list type made of particles. */
-    struct ParticleCell {
-        Particle particle;
-        ParticleCell* next;
-        ParticleCell* prev;
+    /* The particles, stored as structures of arrays (see ParticleStore.h),
+     * with one store per particle type. Every particle in a store follows
+     * the same rules, so moving a store needs no per-particle checks of the
+     * type. Within a store, particles are kept in the order they were added.
+     */
+    static const int kNumTypes = 3;
+    ParticleStore _buckets[kNumTypes];
 
-        TRACK_ALLOCATIONS_OF(ParticleCell);
-    };
+    /* Number of particles ever added, used to number each new particle. */
+    long long _numAdded;
+
+    /* Number of calls to moveParticles so far. */
+    long long _numMoves;
 
-    /* Pointer to the first cell in the list of particles, or nullptr if there
-     * are no particles in the list.
+    /* Settings for moveParticles(dt), and the part of a step it has built
+     * up but not yet taken.
      */
-    ParticleCell* _head;
-    ParticleCell* _tail;
-    int _count;
-    void notValidRewire(ParticleCell* particleCell);
-    void fireworkCreate(ParticleCell* cur, Color color);
-    void streamerFunction(ParticleCell* cur);
+    double _stepRate;
+    int _maxSteps;
+    double _stepProgress;
 
-    /* TODO: Add any new member variables or helper functions here. Make sure
-     * to delete this comment before submitting.
+    /* When each particle next needs checking, by the value _numMoves will
+     * have after the move, with one wheel per particle type. The wheels hold
+     * serial numbers, which find the particles again since a stable store is
+     * kept in order of serial number. Every particle is in its wheel exactly
+     * once. Only used with RemovalPolicy::STABLE; otherwise every particle
+     * is checked on every move.
      */
+    TimingWheel _checks[kNumTypes];
 
+    /* Streamers from fireworks that exploded during the current tick. They
+     * are added all at once when the tick is over.
+     */
+    std::vector<Particle> _spawnQueue;
 
+    /* Random numbers for this system. Each chunk of fireworks being moved
+     * gets its own stream, seeded from this generator once per tick.
+     */
+    ParticleRandom _random;
+
+    ParticleBounds _bounds;
+    RemovalPolicy _removalPolicy;
+    DrawOrder _drawOrder;
+    Motion _motion;
+
+    /* Space for merging the stores back into insertion order when drawing.
+     * Kept between calls so the memory gets reused.
+     */
+    mutable std::vector<double> _drawX, _drawY;
+    mutable std::vector<Color> _drawColor;
+
+    /* Where the particles of each type are now, worked out when drawing with
+     * Motion::LAZY.
+     */
+    mutable std::vector<double> _lazyX[kNumTypes], _lazyY[kNumTypes];
+
+    /* Every particle filed by position, for finding neighbors. Point i of
+     * the grid is particle i of the list made by joining the stores in
+     * type order. Only rebuilt when it's needed and the particles have
+     * changed since it was last built.
+     */
+    mutable SpatialGrid _grid;
+    mutable bool _gridStale;
+    mutable std::vector<double> _gridX, _gridY;
+    double _neighborCellSize;
+
+    /* The interaction between particles, if any, how far it reaches, space
+     * for the pushes each particle gets, and the particles' velocities and
+     * types joined in the same order as the grid's positions.
+     */
+    Interaction _interaction;
+    double _interactionRadius;
+    std::vector<Push> _pushes;
+    std::vector<double> _interactDX, _interactDY;
+    std::vector<ParticleType> _interactType;
+
+    /* Rectangles particles run into, and forces that act on particles. */
+    ColliderSet _colliders;
+    ForcePipeline _forces;
+
+#ifdef PARTICLE_STATS
+    /* Stats for recent ticks, and the stats for the tick in progress. These
+     * only exist when built with PARTICLE_STATS.
+     */
+    mutable ParticleStats _stats;
+    TickStats _tickStats;
+#endif
+
+    /* Threads for moving particles in parallel, or nullptr if only the
+     * calling thread is used.
+     */
+    std::unique_ptr<WorkerPool> _workers;
+
+    /* What happened in one chunk of particles during a call to
+     * moveParticles: the streamers from fireworks that exploded, which
+     * particles were absorbed by colliders, and which particles need to be
+     * removed, in increasing order. Chunks are listed
+     * in order, so joining their lists gives the same answer however the
+     * chunks were divided among threads. The lists, and the chunk's space
+     * for marking valid particles, are kept between calls so their memory
+     * gets reused.
+     */
+    struct ChunkResult {
+        std::vector<Particle> spawned;
+        std::vector<int> kills;
+        std::vector<unsigned char> valid;
+        std::vector<unsigned char> absorbed;
+    };
+    std::vector<ChunkResult> _chunks;
+    int _numChunks;
+
+    ParticleStore& bucket(ParticleType type);
+    const ParticleStore& bucket(ParticleType type) const;
+
+    void moveBucket(ParticleType type);
+    int quietMoves(int limit);
+    void moveQuietly(int numMoves);
+    void moveChunk(ParticleType type, int begin, int end, bool cull, ParticleRandom& random,
+                   ChunkResult& result);
+    void explode(const ParticleStore& fireworks, int index, ParticleRandom& random,
+                 std::vector<Particle>& spawned);
+    bool schedulingChecks() const;
+    bool movingEveryParticle() const;
+    void collideChunk(ParticleType type, int begin, int end, ChunkResult& result);
+    void scheduleCheck(ParticleType type, int index);
+    void scheduleFrom(ParticleType type, int first);
+    void admitFrom(ParticleType type, int first);
+    void rebase(ParticleType type, int index);
+    void positions(int type, const double*& xs, const double*& ys) const;
+    void rescheduleAll();
+    void runChecks(ParticleType type, uint64_t tickSeed);
+    int removeStable(ParticleStore& store);
+    void removeUnstable(ParticleStore& store);
+    void drawInsertionOrder() const;
+    void countRemovals(ParticleType type);
+    void buildGrid() const;
+    const ParticleStore& storeHolding(int& index) const;
+    void interact();
+    long long bytesInUse() const;
 
     /* Allows SimpleTest to peek inside the ParticleSystem type. */
     ALLOW_TEST_ACCESS();
 };
+
+/* * * * * Implementation Below This Point * * * * */
+
+template <typename Generator>
+void ParticleSystem::emit(int count, ParticleType type, Generator generate) {
+    ParticleStore& store = bucket(type);
+    int first = store.emit(count, [&](Particle& particle) {
+        generate(particle);
+        particle.type = type;
+    });
+    store.removeInvalid(first, _bounds);
+
+    for (int i = first; i < store.size(); i++) {
+        store.serial[i] = _numAdded;
+        _numAdded++;
+    }
+    admitFrom(type, first);
+}
+
+template <typename Generator>
+void ParticleSystem::emitSparse(int numTrials, double probability, ParticleType type,
+                                Generator generate) {
+    ParticleStore& store = bucket(type);
+    int first = store.size();
+    _random.forEachSuccess(numTrials, probability, [&](int trial) {
+        Particle particle;
+        generate(particle, trial);
+        particle.type = type;
+        store.push(particle);
+    });
+    store.removeInvalid(first, _bounds);
+
+    for (int i = first; i < store.size(); i++) {
+        store.serial[i] = _numAdded;
+        _numAdded++;
+    }
+    admitFrom(type, first);
+}
+
+template <typename Function>
+void ParticleSystem::forEachNeighbor(double x, double y, double radius, Function fn) const {
+    buildGrid();
+    _grid.forEachNear(x, y, radius, [&](int id, double) {
+        const ParticleStore& store = storeHolding(id);
+        fn(store.get(id));
+    });
+}
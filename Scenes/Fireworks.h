@@ -16,6 +16,12 @@ public:
     void tick();
     void draw();
 
+    /* Makes a rocket launched from the bottom of the scene. Static so the
+     * benchmarks (see ParticleBenchmarks.h) can launch the same rockets as
+     * the scene.
+     */
+    static Particle makeRocket(ParticleRandom& random);
+
 private:
     ParticleSystem system;
 };
@@ -26,6 +26,10 @@ const int kMinWhite = 60;
 const int kMaxWhite = 210;
 
 Fountain::Fountain() {
+    emitters = emitterLocations();
+}
+
+Vector<GPoint> Fountain::emitterLocations() {
     /* Rough sketch of the fountain:
      *
      *            *
@@ -41,59 +45,62 @@ Fountain::Fountain() {
      * Each * here is an emitter. The | and -- lines represent the same
      * spacing.
      */
+    Vector<GPoint> result;
     double bottomRowY = SCENE_HEIGHT - 1 - 2 * kSpacing;
-    emitters.add({ SCENE_WIDTH / 2 - 2 * kSpacing, bottomRowY });
-    emitters.add({ SCENE_WIDTH / 2 - 1 * kSpacing, bottomRowY });
-    emitters.add({ SCENE_WIDTH / 2 + 1 * kSpacing, bottomRowY });
-    emitters.add({ SCENE_WIDTH / 2 + 2 * kSpacing, bottomRowY });
+    result.add({ SCENE_WIDTH / 2 - 2 * kSpacing, bottomRowY });
+    result.add({ SCENE_WIDTH / 2 - 1 * kSpacing, bottomRowY });
+    result.add({ SCENE_WIDTH / 2 + 1 * kSpacing, bottomRowY });
+    result.add({ SCENE_WIDTH / 2 + 2 * kSpacing, bottomRowY });
 
     double middleRowY = SCENE_HEIGHT - 1 - 4 * kSpacing;
-    emitters.add({ SCENE_WIDTH / 2 - 1 * kSpacing, middleRowY });
-    emitters.add({ SCENE_WIDTH / 2 + 1 * kSpacing, middleRowY });
+    result.add({ SCENE_WIDTH / 2 - 1 * kSpacing, middleRowY });
+    result.add({ SCENE_WIDTH / 2 + 1 * kSpacing, middleRowY });
 
     double topRowY = SCENE_HEIGHT - 1 - 6 * kSpacing;
-    emitters.add({ SCENE_WIDTH / 2, topRowY });
-    emitters.add({ SCENE_WIDTH / 2, topRowY });
+    result.add({ SCENE_WIDTH / 2, topRowY });
+    result.add({ SCENE_WIDTH / 2, topRowY });
+    return result;
 }
 
 void Fountain::tick() {
     /* Each source emits water. */
     for (GPoint source: emitters) {
-        /* Each source emits multiple particles. */
-        for (int i = 0; i < kFlowRate; i++) {
-            /* Pick an angle and fire water at that angle. */
-            double theta = randomReal(kMinAngle, kMaxAngle);
-
-            /* Select a speed. */
-            double speed = randomReal(kMinWaterSpeed, kMaxWaterSpeed);
-
-            /* dy is negative because positive y corresponds to moving down. */
-            double dx =  speed * cos(theta);
-            double dy = -speed * sin(theta);
-
-            /* Set this up as a particle. */
-            Particle data;
-            data.color = waterColor();
-            data.x = source.x;
-            data.y = source.y;
-            data.dx = dx;
-            data.dy = dy;
-            data.type = ParticleType::BALLISTIC;
-            data.lifetime = INT_MAX; // Particle only disappears when falling off the frame.
-
-            system.add(data);
-        }
+        /* Each source emits multiple particles, written into the system as a batch. */
+        system.emit(kFlowRate, [&](Particle& data) {
+            makeWater(data, source, system.random());
+        });
     }
 
     system.moveParticles();
 }
 
+void Fountain::makeWater(Particle& data, GPoint source, ParticleRandom& random) {
+    /* Pick an angle and fire water at that angle. */
+    double theta = random.real(kMinAngle, kMaxAngle);
+
+    /* Select a speed. */
+    double speed = random.real(kMinWaterSpeed, kMaxWaterSpeed);
+
+    /* dy is negative because positive y corresponds to moving down. */
+    double dx =  speed * cos(theta);
+    double dy = -speed * sin(theta);
+
+    /* Set this up as a particle. */
+    data.color = waterColor(random);
+    data.x = source.x;
+    data.y = source.y;
+    data.dx = dx;
+    data.dy = dy;
+    data.type = ParticleType::BALLISTIC;
+    data.lifetime = INT_MAX; // Particle only disappears when falling off the frame.
+}
+
 /* Picks a color for a particle of water. The particle always has the maximum
  * possible blue component and has a red/green component that is randomly
  * chosen.
  */
-Color Fountain::waterColor() const {
-    int white = randomInteger(kMinWhite, kMaxWhite);
+Color Fountain::waterColor(ParticleRandom& random) {
+    int white = random.integer(kMinWhite, kMaxWhite);
     return Color(white, white, 255);
 }
 
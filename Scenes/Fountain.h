@@ -6,7 +6,7 @@
 #pragma once
 
 #include "Demos/Scene.h"
-#include "ParticleSystem.h"
+#include "BasicParticleSystem.h"
 #include "vector.h"
 #include "gobjects.h"
 
@@ -17,12 +17,24 @@ public:
     void tick();
     void draw();
 
+    /* Sets up a drop of water sprayed from the given emitter. Static, along
+     * with emitterLocations, so the benchmarks (see ParticleBenchmarks.h)
+     * can make the same water as the scene.
+     */
+    static void makeWater(Particle& data, GPoint source, ParticleRandom& random);
+
+    /* Where the emitters are. */
+    static Vector<GPoint> emitterLocations();
+
 private:
-    ParticleSystem system;
+    /* Water falls under gravity and disappears off the edge of the scene.
+     * There's a lot of it, so it's stored compactly.
+     */
+    CompactParticleSystem<Gravity<1>, CullOutOfBounds> system;
 
     /* Where the emitters are. */
     Vector<GPoint> emitters;
 
     /* Make a nice water color. */
-    Color waterColor() const;
+    static Color waterColor(ParticleRandom& random);
 };
@@ -0,0 +1,184 @@
+#include "HeadlessRunner.h"
+#include "DrawParticle.h"
+#include "Fireworks.h"
+#include "Fountain.h"
+#include "MagicWand.h"
+#include "PhotoExploder.h"
+#include "SnowyDay.h"
+#include "Demos/ParticleCatcher.h"
+#include "GUI/SimpleTest.h"
+#include "error.h"
+#include "map.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+using namespace std;
+
+double HeadlessRun::framesPerSecond() const {
+    return seconds == 0 ? 0 : numFrames / seconds;
+}
+
+double HeadlessRun::particlesPerFrame() const {
+    return numFrames == 0 ? 0 : double(particlesDrawn) / numFrames;
+}
+
+namespace {
+    /* Any scene, seen as just its tick and draw functions. */
+    class HeadlessScene {
+    public:
+        virtual ~HeadlessScene() = default;
+        virtual void tick() = 0;
+        virtual void draw() = 0;
+    };
+
+    template <typename SceneType> class HeadlessSceneOf: public HeadlessScene {
+    public:
+        void tick() override {
+            scene.tick();
+        }
+        void draw() override {
+            scene.draw();
+        }
+
+    private:
+        SceneType scene;
+    };
+
+    /* Every scene that can be run, by name. To add a scene, add a line here. */
+    using SceneMaker = function<unique_ptr<HeadlessScene> ()>;
+
+    template <typename SceneType> SceneMaker maker() {
+        return [] {
+            return unique_ptr<HeadlessScene>(new HeadlessSceneOf<SceneType>());
+        };
+    }
+
+    const Map<string, SceneMaker>& allScenes() {
+        static const Map<string, SceneMaker> scenes = {
+            { "Fireworks",     maker<Fireworks>()     },
+            { "Fountain",      maker<Fountain>()      },
+            { "MagicWand",     maker<MagicWand>()     },
+            { "PhotoExploder", maker<PhotoExploder>() },
+            { "SnowyDay",      maker<SnowyDay>()      },
+        };
+        return scenes;
+    }
+}
+
+namespace {
+    /* While one of these exists, particles drawn in batches are counted
+     * instead of drawn. Whatever batch draw function was installed before
+     * is put back when it goes away, even if a scene threw.
+     */
+    class CountDrawnParticles {
+    public:
+        explicit CountDrawnParticles(long long& counter): saved(batchDrawFunction()) {
+            setBatchDrawFunction([&counter](const double*, const double*, const Color*, int count) {
+                counter += count;
+            });
+        }
+        ~CountDrawnParticles() {
+            setBatchDrawFunction(saved);
+        }
+
+        CountDrawnParticles(const CountDrawnParticles&) = delete;
+        CountDrawnParticles& operator= (const CountDrawnParticles&) = delete;
+
+    private:
+        BatchDrawFunction saved;
+    };
+
+    HeadlessRun runScene(const string& sceneName, HeadlessScene& scene, int numFrames, bool draw) {
+        long long particlesDrawn = 0;
+        CountDrawnParticles counting(particlesDrawn);
+
+        auto start = chrono::steady_clock::now();
+        for (int frame = 0; frame < numFrames; frame++) {
+            scene.tick();
+            if (draw) {
+                scene.draw();
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        return { sceneName, numFrames, seconds, particlesDrawn };
+    }
+}
+
+HeadlessRun runHeadless(const string& sceneName, int numFrames, bool draw) {
+    if (!allScenes().containsKey(sceneName)) {
+        error("No scene named " + sceneName);
+    }
+    unique_ptr<HeadlessScene> scene = allScenes()[sceneName]();
+    return runScene(sceneName, *scene, numFrames, draw);
+}
+
+Vector<string> headlessSceneNames() {
+    Vector<string> result;
+    for (string name: allScenes()) {
+        result += name;
+    }
+    return result;
+}
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("headless runner ticks and draws a scene and counts its particles") {
+    HeadlessRun run = runHeadless("Fountain", 10);
+    EXPECT_EQUAL(run.scene, "Fountain");
+    EXPECT_EQUAL(run.numFrames, 10);
+    EXPECT(run.particlesDrawn > 0);
+    EXPECT(run.particlesPerFrame() > 0);
+
+    /* Without drawing, nothing is counted. */
+    EXPECT_EQUAL(runHeadless("SnowyDay", 10, false).particlesDrawn, 0);
+
+    EXPECT_ERROR(runHeadless("NoSuchScene", 1));
+}
+
+namespace {
+    /* A scene that draws one particle a frame and throws partway through. */
+    class ThrowingScene: public HeadlessScene {
+    public:
+        void tick() override {
+            if (++numTicks == 3) {
+                error("Scene broke");
+            }
+        }
+        void draw() override {
+            double x = 1, y = 2;
+            Color color;
+            drawParticleBatch(&x, &y, &color, 1);
+        }
+
+    private:
+        int numTicks = 0;
+    };
+}
+
+STUDENT_TEST("headless runner puts the drawing functions back when a scene throws") {
+    /* Nothing was installed, so afterward drawing goes one particle at a
+     * time to the draw function again.
+     */
+    ParticleCatcher catcher;
+    ThrowingScene first;
+    EXPECT_ERROR(runScene("Throwing", first, 10, true));
+
+    double x = 3, y = 4;
+    Color color;
+    drawParticleBatch(&x, &y, &color, 1);
+    EXPECT_EQUAL(catcher.numDrawn(), 1);
+    EXPECT_EQUAL(catcher[0].x, 3);
+
+    /* An installed batch draw function is put back too. */
+    int numBatched = 0;
+    setBatchDrawFunction([&](const double*, const double*, const Color*, int count) {
+        numBatched += count;
+    });
+    ThrowingScene second;
+    EXPECT_ERROR(runScene("Throwing", second, 10, true));
+    drawParticleBatch(&x, &y, &color, 1);
+    EXPECT_EQUAL(numBatched, 1);
+    EXPECT_EQUAL(catcher.numDrawn(), 1);
+    setBatchDrawFunction(nullptr);
+}
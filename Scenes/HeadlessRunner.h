@@ -0,0 +1,47 @@
+/******************************************************************************
+ * File: HeadlessRunner.h
+ *
+ * Runs scenes without the graphics window, as fast as they'll go, for
+ * measuring how much simulation the machine can keep up with. Each frame
+ * calls the scene's tick() and, optionally, draw(). Particles drawn are
+ * counted rather than shown, using setBatchDrawFunction (see
+ * DrawParticle.h); any other shapes the scene draws still go to the scene's
+ * canvas.
+ *
+ * Scenes are looked up by the name of their class:
+ *
+ *     HeadlessRun run = runHeadless("Fountain", 1000);
+ *     cout << run.framesPerSecond() << " fps, "
+ *          << run.particlesPerFrame() << " particles per frame" << endl;
+ */
+#pragma once
+
+#include "vector.h"
+#include <string>
+
+/* What happened during a headless run. */
+struct HeadlessRun {
+    std::string scene;        // Which scene was run
+    int numFrames;            // How many frames were run
+    double seconds;           // Time taken by all the frames
+    long long particlesDrawn; // Particles drawn, over all frames
+
+    /* Frames run per second of real time. */
+    double framesPerSecond() const;
+
+    /* Average number of particles drawn per frame. This is zero if the run
+     * didn't draw.
+     */
+    double particlesPerFrame() const;
+};
+
+/* Creates the named scene and runs it for the given number of frames with
+ * no pause between them. If 'draw' is false, only tick() is called. Reports
+ * an error if there's no scene by that name. The draw function is left
+ * alone, and the batch draw function is put back the way it was when the
+ * run is over, even if the scene throws.
+ */
+HeadlessRun runHeadless(const std::string& sceneName, int numFrames, bool draw = true);
+
+/* Returns the names of all the scenes runHeadless can run. */
+Vector<std::string> headlessSceneNames();
@@ -35,33 +35,33 @@ void MagicWand::tick()  {
      * position - which is also where the tip of the magic wand is.
      */
     if (mouseDown) {
-        for (int i = 0; i < kDownRate; i++) {
-            /* Random angle / speed to fire the particle. */
-            double theta  = randomReal(0, 2 * M_PI);
-            double speed = randomReal(kMinStreamerSpeed, kMaxStreamerSpeed);
-
-            /* How long the particle lives for. */
-            int lifetime  = randomInteger(kMinLifetime, kMaxLifetime);
+        ParticleRandom& random = system.random();
+        system.emit(kDownRate, ParticleType::STREAMER, [&](Particle& particle) {
+            makeSparkle(particle, mouse, random);
+        });
+    }
 
-            Particle particle;
+    system.moveParticles();
+}
 
-            /* Center on the mouse. */
-            particle.x = mouse.x;
-            particle.y = mouse.y;
+void MagicWand::makeSparkle(Particle& particle, GPoint tip, ParticleRandom& random) {
+    /* Random angle / speed to fire the particle. */
+    double theta  = random.real(0, 2 * M_PI);
+    double speed = random.real(kMinStreamerSpeed, kMaxStreamerSpeed);
 
-            /* Polar coordinates to the rescue! */
-            particle.dx = speed * cos(theta);
-            particle.dy = speed * sin(theta);
+    /* How long the particle lives for. */
+    int lifetime  = random.integer(kMinLifetime, kMaxLifetime);
 
-            particle.lifetime = lifetime;
-            particle.type = ParticleType::STREAMER;
-            particle.color = Color::random();
+    /* Center on the tip. */
+    particle.x = tip.x;
+    particle.y = tip.y;
 
-            system.add(particle);
-        }
-    }
+    /* Polar coordinates to the rescue! */
+    particle.dx = speed * cos(theta);
+    particle.dy = speed * sin(theta);
 
-    system.moveParticles();
+    particle.lifetime = lifetime;
+    particle.color = random.color();
 }
 
 void MagicWand::draw() {
@@ -83,16 +83,17 @@ void MagicWand::mouseMoved(double x, double y) {
     mouse = { x, y };
 
     /* Create particles that emanates from the mouse position. */
+    ParticleRandom& random = system.random();
     for (int i = 0; i < kMoveRate; i++) {
         Particle particle;
         particle.x = x;
         particle.y = y;
 
-        particle.dx = randomReal(kMinMoveX, kMaxMoveX);
-        particle.dy = randomReal(kMinMoveY, kMaxMoveY);
+        particle.dx = random.real(kMinMoveX, kMaxMoveX);
+        particle.dy = random.real(kMinMoveY, kMaxMoveY);
 
         particle.lifetime = INT_MAX; // Live forever, basically
-        particle.color = Color::random();
+        particle.color = random.color();
 
         particle.type = ParticleType::BALLISTIC;
         system.add(particle);
@@ -19,6 +19,12 @@ public:
     void mouseReleased(double x, double y);
     void mouseDragged(double x, double y);
 
+    /* Sets up one particle of the shower from the tip of the wand. Static so
+     * the benchmarks (see ParticleBenchmarks.h) can make the same shower as
+     * the scene.
+     */
+    static void makeSparkle(Particle& particle, GPoint tip, ParticleRandom& random);
+
 private:
     ParticleSystem system;
 
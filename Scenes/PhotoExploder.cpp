@@ -2,8 +2,11 @@
 #include "GUI/MiniGUI.h"
 #include "gobjects.h"
 #include "filelib.h"
+#include "grid.h"
 #include "set.h"
 #include "random.h"
+#include "CompactParticleStore.h"
+#include <fstream>
 using namespace std;
 
 /* Countdown timer - in frames. */
@@ -28,6 +31,11 @@ const double kMaxSpeed = 4;
 /* Pixel spacing. */
 const double kPixelSpacing = 3.5;
 
+/* Where sampled images are saved so later runs can skip decoding them. Set
+ * this to the empty string to turn the on-disk cache off.
+ */
+const string kCacheDirectory = "res/photo-cache";
+
 namespace {
     /* Utility function to decode a GImage pixel into a color. */
     Color decode(int value) {
@@ -60,60 +68,193 @@ namespace {
         }
         return result;
     }
-}
 
-PhotoExploder::PhotoExploder() {
-    files = imageFilesIn("res/photos");
-    loadNextImage();
-}
+    /* Picks the points to sample an image at, given its pixels. This only
+     * reads the grid, so unlike decoding the image it can run on a
+     * background thread.
+     */
+    shared_ptr<const PhotoSamples> samplePixels(const Grid<int>& pixels) {
+        int width = pixels.numCols();
+        int height = pixels.numRows();
 
-void PhotoExploder::setImage(const string& filename) {
-    /* Load the image. */
-    GImage image(filename);
+        /* Get a bounding box for the image. */
+        auto bounds = fitToBounds(PhotoExploder::contentArea(), double(width) / height);
 
-    /* Content area - where the image is allowed to go. */
-    GRectangle contentArea = {
-        kPadding * SCENE_WIDTH,
-        kPadding * SCENE_HEIGHT,
-        (1.0 - 2 * kPadding) * SCENE_WIDTH,
-        (1.0 - 2 * kPadding) * SCENE_HEIGHT
+        /* For each sample point in the bounds, record where it goes and what
+         * color it is. The points go column by column.
+         */
+        int numCols = ceil(bounds.width  / kPixelSpacing);
+        int numRows = ceil(bounds.height / kPixelSpacing);
+        auto result = make_shared<PhotoSamples>();
+        for (int sample = 0; sample < numCols * numRows; sample++) {
+            double x = (sample / numRows) * kPixelSpacing;
+            double y = (sample % numRows) * kPixelSpacing;
+
+            /* Which pixel should we extract? */
+            int srcX = min(int(x * width  / bounds.width),  width - 1);
+            int srcY = min(int(y * height / bounds.height), height - 1);
+
+            result->x.push_back(bounds.x + x);
+            result->y.push_back(bounds.y + y);
+            result->color.push_back(decode(pixels[srcY][srcX]));
+        }
+        return result;
+    }
+
+    /* The on-disk cache keeps one file per image, laid out as
+     *
+     *     "PXS2"                      4 bytes
+     *     image file size             int64
+     *     image fingerprint           uint64
+     *     content area x, y, w, h     4 doubles
+     *     number of samples n         int32
+     *     x coordinates               n doubles
+     *     y coordinates               n doubles
+     *     colors as 0xRRGGBBAA        n uint32s
+     *
+     * in the machine's own byte order. A cache file is only used if the
+     * image has the same size and contents and the content area hasn't
+     * changed, so editing either makes the scene sample the image again.
+     * A file that's cut short, or doesn't hold exactly n samples, is
+     * ignored too.
+     */
+    const char kCacheMagic[4] = { 'P', 'X', 'S', '2' };
+    const int64_t kBytesPerSample = 2 * sizeof(double) + sizeof(PackedColor);
+
+    /* What a cache file has to match about the image it was made from. */
+    struct ImageKey {
+        int64_t size;
+        uint64_t fingerprint;
     };
 
-    /* Get a bounding box for the image. */
-    auto bounds = fitToBounds(contentArea, image.getWidth() / image.getHeight());
+    string cacheFileFor(const string& filename) {
+        return kCacheDirectory + "/" + getTail(filename) + ".samples";
+    }
 
-    /* For each pixel in the bounds, create a particle. */
-    for (double x = 0; x < bounds.width; x += kPixelSpacing) {
-        for (double y = 0; y < bounds.height; y += kPixelSpacing) {
-            /* Which pixel should we extract? */
-            double srcX = x * image.getWidth()  / bounds.width;
-            double srcY = y * image.getHeight() / bounds.height;
+    /* Reads through an image file, working out its size and a 64-bit FNV-1a
+     * hash of its contents. That's far cheaper than decoding the image.
+     */
+    ImageKey keyFor(const string& filename) {
+        ImageKey key = { 0, 0xcbf29ce484222325ULL };
+        ifstream input(filename, ios::binary);
+        char buffer[4096];
+        while (input.read(buffer, sizeof(buffer)) || input.gcount() > 0) {
+            for (streamsize i = 0; i < input.gcount(); i++) {
+                key.fingerprint = (key.fingerprint ^ (unsigned char) buffer[i]) * 0x100000001b3ULL;
+            }
+            key.size += input.gcount();
+        }
+        return key;
+    }
 
-            addParticle(bounds.x + x, bounds.y + y, decode(image.getPixel(srcX, srcY)));
+    template <typename T> void writeArray(ostream& out, const T* values, int count) {
+        out.write(reinterpret_cast<const char*>(values), sizeof(T) * count);
+    }
+    template <typename T> bool readArray(istream& in, T* values, int count) {
+        return bool(in.read(reinterpret_cast<char*>(values), sizeof(T) * count));
+    }
+
+    void writeCache(const string& filename, const ImageKey& key, const PhotoSamples& samples) {
+        if (!isDirectory(kCacheDirectory)) {
+            createDirectory(kCacheDirectory);
         }
+        ofstream out(cacheFileFor(filename), ios::binary);
+        if (!out) return;
+
+        GRectangle area = PhotoExploder::contentArea();
+        double areaValues[4] = { area.x, area.y, area.width, area.height };
+        int32_t count = samples.x.size();
+        vector<PackedColor> colors(samples.color.begin(), samples.color.end());
+
+        writeArray(out, kCacheMagic, 4);
+        writeArray(out, &key.size, 1);
+        writeArray(out, &key.fingerprint, 1);
+        writeArray(out, areaValues, 4);
+        writeArray(out, &count, 1);
+        writeArray(out, samples.x.data(), count);
+        writeArray(out, samples.y.data(), count);
+        writeArray(out, colors.data(), count);
     }
 
-    /* Reset the countdown. */
-    countdown  = kCountdownTime;
-    stepsLeft  = kNumSteps;
-    imagePause = kImageSteps;
-}
+    shared_ptr<const PhotoSamples> readCache(const string& filename, const ImageKey& key) {
+        ifstream in(cacheFileFor(filename), ios::binary);
 
-void PhotoExploder::loadNextImage() {
-    /* Using the 'looper' strategy from class, grab the next image from
-     * the queue, load it, and put it back into the queue.
+        char magic[4];
+        ImageKey cached;
+        double areaValues[4];
+        int32_t count;
+        if (!readArray(in, magic, 4) || !equal(magic, magic + 4, kCacheMagic) ||
+            !readArray(in, &cached.size, 1) || cached.size != key.size ||
+            !readArray(in, &cached.fingerprint, 1) || cached.fingerprint != key.fingerprint ||
+            !readArray(in, areaValues, 4) || !readArray(in, &count, 1) || count < 0) {
+            return nullptr;
+        }
+        GRectangle area = PhotoExploder::contentArea();
+        if (areaValues[0] != area.x || areaValues[1] != area.y ||
+            areaValues[2] != area.width || areaValues[3] != area.height) {
+            return nullptr;
+        }
+
+        /* Only allocate room for the samples once the file is known to hold
+         * exactly that many.
+         */
+        streampos samplesStart = in.tellg();
+        in.seekg(0, ios::end);
+        if (!in || in.tellg() - samplesStart != count * kBytesPerSample) {
+            return nullptr;
+        }
+        in.seekg(samplesStart);
+
+        auto result = make_shared<PhotoSamples>();
+        result->x.resize(count);
+        result->y.resize(count);
+        vector<PackedColor> colors(count);
+        if (!readArray(in, result->x.data(), count) || !readArray(in, result->y.data(), count) ||
+            !readArray(in, colors.data(), count)) {
+            return nullptr;
+        }
+        result->color.assign(colors.begin(), colors.end());
+        return result;
+    }
+
+    /* Looks for an image's samples in the disk cache, returning nullptr if
+     * they aren't there. Runs on a background thread.
      */
-    string next = files.dequeue();
-    setImage(next);
-    files.enqueue(next);
-}
+    shared_ptr<const PhotoSamples> readCachedSamples(const string& filename) {
+        if (kCacheDirectory.empty()) return nullptr;
+        return readCache(filename, keyFor(filename));
+    }
+
+    /* Samples an image from its pixels and saves the samples to the disk
+     * cache. Runs on a background thread.
+     */
+    shared_ptr<const PhotoSamples> sampleAndCache(const string& filename, const Grid<int>& pixels) {
+        shared_ptr<const PhotoSamples> samples = samplePixels(pixels);
+        if (!kCacheDirectory.empty()) {
+            writeCache(filename, keyFor(filename), *samples);
+        }
+        return samples;
+    }
 
-void PhotoExploder::addParticle(double x, double y, Color color) {
-    Particle particle;
+    /* Makes the particles that will assemble an image from its samples.
+     * Runs on a background thread, so it only touches its own data;
+     * 'samples' is shared, but it's never changed.
+     */
+    LoadedPhoto aimParticles(shared_ptr<const PhotoSamples> samples, uint64_t seed) {
+        /* Copy the sample points over and give each a fresh velocity. */
+        ParticleRandom random(seed);
+        vector<Particle> particles(samples->x.size());
+        for (size_t i = 0; i < particles.size(); i++) {
+            PhotoExploder::aimParticle(particles[i], samples->x[i], samples->y[i], samples->color[i], random);
+        }
+        return { samples, particles };
+    }
+}
 
+void PhotoExploder::aimParticle(Particle& particle, double x, double y, Color color, ParticleRandom& random) {
     /* Choose a random angle and speed. */
-    double theta = randomReal(0, 2 * M_PI);
-    double speed = randomReal(kMinSpeed, kMaxSpeed);
+    double theta = random.real(0, 2 * M_PI);
+    double speed = random.real(kMinSpeed, kMaxSpeed);
 
     particle.dx = speed * cos(theta);
     particle.dy = speed * sin(theta);
@@ -125,10 +266,113 @@ void PhotoExploder::addParticle(double x, double y, Color color) {
     particle.lifetime = kNumSteps;
 
     particle.color = color;
-    system.add(particle);
+}
+
+GRectangle PhotoExploder::contentArea() {
+    return {
+        kPadding * SCENE_WIDTH,
+        kPadding * SCENE_HEIGHT,
+        (1.0 - 2 * kPadding) * SCENE_WIDTH,
+        (1.0 - 2 * kPadding) * SCENE_HEIGHT
+    };
+}
+
+PhotoExploder::PhotoExploder() {
+    /* Every particle flies in a straight line, so there's no need to move
+     * them one at a time; their positions are worked out when drawn.
+     */
+    system.setMotion(Motion::LAZY);
+
+    files = imageFilesIn("res/photos");
+    startLoading();
+    loadNextImage();
+}
+
+void PhotoExploder::startLoading() {
+    /* Using the 'looper' strategy from class, grab the next image from
+     * the queue and put it back into the queue.
+     */
+    nextFile = files.dequeue();
+    files.enqueue(nextFile);
+
+    /* If we've seen it before, go straight to making its particles.
+     * Otherwise, look for its samples in the disk cache in the background;
+     * continueLoading takes it from there.
+     */
+    shared_ptr<const PhotoSamples> samples = samplesCache.get(nextFile);
+    if (samples != nullptr) {
+        makeParticles(samples);
+    }
+    else {
+        string filename = nextFile;
+        cachedSamples = async(launch::async, [filename] {
+            return readCachedSamples(filename);
+        });
+    }
+}
+
+void PhotoExploder::continueLoading() {
+    if (!cachedSamples.valid() ||
+        cachedSamples.wait_for(chrono::seconds(0)) != future_status::ready) {
+        return;
+    }
+
+    shared_ptr<const PhotoSamples> samples = cachedSamples.get();
+    if (samples != nullptr) {
+        makeParticles(samples);
+        return;
+    }
+
+    /* Not in the cache, so decode the image. GImages can only be made on
+     * the GUI thread, so that happens here, and the pixels are then sampled
+     * in the background.
+     */
+    Grid<int> pixels = GImage(nextFile).toGrid();
+    uint64_t seed = system.random().next();
+    string filename = nextFile;
+    nextImage = async(launch::async, [filename, pixels = move(pixels), seed] {
+        return aimParticles(sampleAndCache(filename, pixels), seed);
+    });
+}
+
+void PhotoExploder::makeParticles(shared_ptr<const PhotoSamples> samples) {
+    /* The background thread gets its own random numbers, since the system's
+     * generator belongs to this thread.
+     */
+    uint64_t seed = system.random().next();
+    nextImage = async(launch::async, [samples, seed] {
+        return aimParticles(samples, seed);
+    });
+}
+
+void PhotoExploder::loadNextImage() {
+    /* On startup, the first image is needed right away, so wait for the
+     * cache to be checked rather than polling for it each tick.
+     */
+    while (!nextImage.valid()) {
+        cachedSamples.wait();
+        continueLoading();
+    }
+
+    /* Swap in the prepared particles all at once. This only waits if the
+     * image isn't done loading yet, which only happens on startup.
+     */
+    LoadedPhoto image = nextImage.get();
+    samplesCache[nextFile] = image.samples;
+    system.addAll(image.particles.data(), image.particles.size());
+
+    /* Reset the countdown. */
+    countdown  = kCountdownTime;
+    stepsLeft  = kNumSteps;
+    imagePause = kImageSteps;
+
+    /* Get started on the image after this one. */
+    startLoading();
 }
 
 void PhotoExploder::tick() {
+    continueLoading();
+
     /* If the countdown is still active, do nothing. */
     if (countdown > 0) {
         countdown--;
@@ -142,8 +386,10 @@ void PhotoExploder::tick() {
     else if (imagePause > 0) {
         imagePause--;
     }
-    /* Otherwise, reset the image. */
-    else {
+    /* Otherwise, reset the image, as soon as the next one is ready. Until
+     * then, keep marveling.
+     */
+    else if (nextImage.valid() && nextImage.wait_for(chrono::seconds(0)) == future_status::ready) {
         system.moveParticles(); // Clear all particles
         loadNextImage();
     }
@@ -6,7 +6,28 @@
  */
 #include "Demos/Scene.h"
 #include "ParticleSystem.h"
+#include "gobjects.h"
 #include "queue.h"
+#include "map.h"
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Where an image's particles end up, and their colors. These only depend on
+ * the image and where it's drawn, so they're worked out once per image and
+ * then reused every time the image comes around again.
+ */
+struct PhotoSamples {
+    std::vector<double> x, y;
+    std::vector<Color> color;
+};
+
+/* An image that's ready to show: its samples, and particles headed for them. */
+struct LoadedPhoto {
+    std::shared_ptr<const PhotoSamples> samples;
+    std::vector<Particle> particles;
+};
 
 class PhotoExploder: public Scene<PhotoExploder> {
 public:
@@ -15,6 +36,16 @@ public:
     void tick();
     void draw();
 
+    /* Sets up a particle so that it flies in from a random direction and
+     * arrives at (x, y) when its lifetime runs out. Static, along with
+     * contentArea, so the benchmarks (see ParticleBenchmarks.h) can make the
+     * same particles as the scene.
+     */
+    static void aimParticle(Particle& particle, double x, double y, Color color, ParticleRandom& random);
+
+    /* Content area - where the image is allowed to go. */
+    static GRectangle contentArea();
+
 private:
     ParticleSystem system;
     Queue<std::string> files; // Image files to process
@@ -23,7 +54,21 @@ private:
     int stepsLeft;  // Steps before we're done.
     int imagePause; // Number of ticks the image remains for
 
+    /* Samples of every image loaded so far, by filename. */
+    Map<std::string, std::shared_ptr<const PhotoSamples>> samplesCache;
+
+    /* The next image, prepared while the current one is on screen. Its
+     * samples are looked for in the disk cache on another thread; if they
+     * aren't there, the image is decoded on this thread, since GImages can
+     * only be made on the GUI thread, and sampled on another. Its particles
+     * are made on another thread too.
+     */
+    std::string nextFile;
+    std::future<std::shared_ptr<const PhotoSamples>> cachedSamples;
+    std::future<LoadedPhoto> nextImage;
+
+    void startLoading();
+    void continueLoading();
+    void makeParticles(std::shared_ptr<const PhotoSamples> samples);
     void loadNextImage();
-    void setImage(const std::string& filename);
-    void addParticle(double x, double y, Color color);
 };
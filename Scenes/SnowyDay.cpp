@@ -27,27 +27,29 @@ const double kDxRange = 2;
 const double kDownSpeed = 3;
 
 void SnowyDay::tick() {
-    /* Possibly add particles all across the top row. */
-    for (int x = 0; x < SCENE_WIDTH; x++) {
-        if (randomChance(kParticleProbability)) {
-            Particle snowflake;
+    /* Possibly add particles all across the top row. Only the columns that
+     * get a snowflake cost anything, so this is about 20 random draws rather
+     * than one per column.
+     */
+    system.emitSparse(SCENE_WIDTH, kParticleProbability, [&](Particle& snowflake, int x) {
+        makeSnowflake(snowflake, x, system.random());
+    });
 
-            /* Originate from the top. */
-            snowflake.x     = x;
-            snowflake.y     = 0;
+    /* Now move all the particles. */
+    system.moveParticles();
+}
 
-            /* Wind effects. */
-            snowflake.dy    = kDownSpeed;
-            snowflake.dx    = randomReal(-kDxRange, +kDxRange);
+void SnowyDay::makeSnowflake(Particle& snowflake, int x, ParticleRandom& random) {
+    /* Originate from the top. */
+    snowflake.x     = x;
+    snowflake.y     = 0;
 
-            /* Proper color. */
-            snowflake.color = kSnowColor;
-            system.add(snowflake);
-        }
-    }
+    /* Wind effects. */
+    snowflake.dy    = kDownSpeed;
+    snowflake.dx    = random.real(-kDxRange, +kDxRange);
 
-    /* Now move all the particles. */
-    system.moveParticles();
+    /* Proper color. */
+    snowflake.color = kSnowColor;
 }
 
 void SnowyDay::draw() {
@@ -6,15 +6,22 @@
 #pragma once
 
 #include "Demos/Scene.h"
-#include "ParticleSystem.h"
+#include "BasicParticleSystem.h"
 
 class SnowyDay: public Scene<SnowyDay> {
 public:
     void tick();
     void draw();
 
+    /* Sets up a snowflake starting at column x of the top row. Static so the
+     * benchmarks (see ParticleBenchmarks.h) can make the same snow as the
+     * scene.
+     */
+    static void makeSnowflake(Particle& snowflake, int x, ParticleRandom& random);
+
 private:
-    ParticleSystem system;
+    /* Snowflakes drift in straight lines until they leave the scene. */
+    CompactParticleSystem<CullOutOfBounds> system;
 
     void drawWindow();
 };
@@ -0,0 +1,130 @@
+#include "SpatialGrid.h"
+#include "ParticleRandom.h"
+#include "GUI/SimpleTest.h"
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+/* Number of points handed to a thread at a time when finding cells. */
+const int kGridChunkSize = 4096;
+
+int SpatialGrid::size() const {
+    return _ids.size();
+}
+
+int SpatialGrid::colOf(double x) const {
+    double col = floor((x - _minX) / _cellSize);
+    return int(max(0.0, min(col, double(_numCols - 1))));
+}
+
+int SpatialGrid::rowOf(double y) const {
+    double row = floor((y - _minY) / _cellSize);
+    return int(max(0.0, min(row, double(_numRows - 1))));
+}
+
+void SpatialGrid::build(const ParticleBounds& region, double cellSize, const double* x, const double* y,
+                        int count, WorkerPool* workers) {
+    /* Lay out the cells. */
+    _minX = isinf(region.minX) ? 0 : region.minX;
+    _minY = isinf(region.minY) ? 0 : region.minY;
+    double width  = (isinf(region.maxX) ? SCENE_WIDTH  : region.maxX) - _minX;
+    double height = (isinf(region.maxY) ? SCENE_HEIGHT : region.maxY) - _minY;
+    _cellSize = max({ cellSize, width / kMaxCellsPerSide, height / kMaxCellsPerSide });
+    _numCols = max(1, int(ceil(width  / _cellSize)));
+    _numRows = max(1, int(ceil(height / _cellSize)));
+    int numCells = _numCols * _numRows;
+
+    /* Find each point's cell. Each point is independent of the others. */
+    _cellOf.resize(count);
+    auto findCells = [&](int chunk) {
+        int end = min(count, (chunk + 1) * kGridChunkSize);
+        for (int i = chunk * kGridChunkSize; i < end; i++) {
+            _cellOf[i] = rowOf(y[i]) * _numCols + colOf(x[i]);
+        }
+    };
+    int numChunks = (count + kGridChunkSize - 1) / kGridChunkSize;
+    if (workers != nullptr) {
+        workers->run(numChunks, findCells);
+    }
+    else {
+        for (int chunk = 0; chunk < numChunks; chunk++) {
+            findCells(chunk);
+        }
+    }
+
+    /* Count the points in each cell, then work out where each cell starts. */
+    _cellStart.assign(numCells + 1, 0);
+    for (int i = 0; i < count; i++) {
+        _cellStart[_cellOf[i] + 1]++;
+    }
+    for (int cell = 0; cell < numCells; cell++) {
+        _cellStart[cell + 1] += _cellStart[cell];
+    }
+
+    /* Put each point after the ones already placed in its cell. Going
+     * through the cells' starts as a counter and then shifting them back
+     * saves a separate array.
+     */
+    _ids.resize(count);
+    _x.resize(count);
+    _y.resize(count);
+    for (int i = 0; i < count; i++) {
+        int slot = _cellStart[_cellOf[i]]++;
+        _ids[slot] = i;
+        _x[slot] = x[i];
+        _y[slot] = y[i];
+    }
+    for (int cell = numCells; cell > 0; cell--) {
+        _cellStart[cell] = _cellStart[cell - 1];
+    }
+    _cellStart[0] = 0;
+}
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("spatial grid finds the same points as checking every point") {
+    ParticleRandom random(106);
+    const int kNumPoints = 2000;
+    vector<double> xs(kNumPoints), ys(kNumPoints);
+    for (int i = 0; i < kNumPoints; i++) {
+        /* Some points are outside the region, and should still be found. */
+        xs[i] = random.real(-50, SCENE_WIDTH + 50);
+        ys[i] = random.real(-50, SCENE_HEIGHT + 50);
+    }
+
+    WorkerPool workers(3);
+    SpatialGrid grid;
+    grid.build(ParticleBounds(), 16, xs.data(), ys.data(), kNumPoints, &workers);
+    EXPECT_EQUAL(grid.size(), kNumPoints);
+
+    for (int query = 0; query < 200; query++) {
+        double x = random.real(-60, SCENE_WIDTH + 60);
+        double y = random.real(-60, SCENE_HEIGHT + 60);
+        double radius = random.real(0, 60);
+
+        vector<int> found;
+        grid.forEachNear(x, y, radius, [&](int id, double distanceSquared) {
+            EXPECT(distanceSquared <= radius * radius);
+            found.push_back(id);
+        });
+        sort(found.begin(), found.end());
+
+        vector<int> expected;
+        for (int i = 0; i < kNumPoints; i++) {
+            if ((xs[i] - x) * (xs[i] - x) + (ys[i] - y) * (ys[i] - y) <= radius * radius) {
+                expected.push_back(i);
+            }
+        }
+        EXPECT(found == expected);
+    }
+
+    /* Rebuilding replaces the old points. */
+    grid.build(ParticleBounds::unbounded(), 16, xs.data(), ys.data(), 1);
+    EXPECT_EQUAL(grid.size(), 1);
+    int numFound = 0;
+    grid.forEachNear(xs[0], ys[0], 1, [&](int id, double) {
+        EXPECT_EQUAL(id, 0);
+        numFound++;
+    });
+    EXPECT_EQUAL(numFound, 1);
+}
@@ -0,0 +1,88 @@
+/******************************************************************************
+ * File: SpatialGrid.h
+ *
+ * A uniform grid for finding the points near a given spot. The region is
+ * cut into square cells, and each point is filed under the cell it lies in,
+ * so a query only looks at the few cells that overlap it rather than at
+ * every point.
+ *
+ * The grid is rebuilt from scratch whenever the points move, using a
+ * counting sort by cell: one pass to count the points in each cell, one to
+ * turn the counts into where each cell starts, and one to put each point in
+ * place. That's O(n) per build, plus O(number of cells), and the points
+ * end up stored cell by cell so a query reads them from contiguous memory.
+ */
+#pragma once
+
+#include "ParticleBounds.h"
+#include "WorkerPool.h"
+#include <vector>
+
+class SpatialGrid {
+public:
+    /* The most cells along either side. Bigger regions get bigger cells. */
+    static const int kMaxCellsPerSide = 1024;
+
+    /* Files points 0 through count - 1, where point i is at (x[i], y[i]),
+     * replacing whatever was in the grid before. The grid covers the given
+     * region with cells about 'cellSize' across; open sides of the region
+     * stop at the edges of the scene. Points outside the region are filed
+     * under the nearest cell, so they're still found. If 'workers' isn't
+     * nullptr, finding each point's cell is shared among its threads.
+     */
+    void build(const ParticleBounds& region, double cellSize, const double* x, const double* y,
+               int count, WorkerPool* workers = nullptr);
+
+    /* Number of points in the grid. */
+    int size() const;
+
+    /* Calls fn(id, distanceSquared) for each point within 'radius' of
+     * (x, y), where id is the point's number as given to build. Points are
+     * visited cell by cell, in no particular order.
+     */
+    template <typename Function>
+    void forEachNear(double x, double y, double radius, Function fn) const;
+
+private:
+    double _minX = 0, _minY = 0;
+    double _cellSize = 1;
+    int _numCols = 0, _numRows = 0;
+
+    /* The cell each point is in, by id. */
+    std::vector<int> _cellOf;
+
+    /* Points in cell c are entries _cellStart[c] up to _cellStart[c + 1] of
+     * the arrays below.
+     */
+    std::vector<int> _cellStart;
+    std::vector<int> _ids;
+    std::vector<double> _x, _y;
+
+    int colOf(double x) const;
+    int rowOf(double y) const;
+};
+
+/* * * * * Implementation Below This Point * * * * */
+
+template <typename Function>
+void SpatialGrid::forEachNear(double x, double y, double radius, Function fn) const {
+    if (_ids.empty()) return;
+
+    int firstCol = colOf(x - radius), lastCol = colOf(x + radius);
+    int firstRow = rowOf(y - radius), lastRow = rowOf(y + radius);
+    double radiusSquared = radius * radius;
+
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int col = firstCol; col <= lastCol; col++) {
+            int cell = row * _numCols + col;
+            for (int i = _cellStart[cell]; i < _cellStart[cell + 1]; i++) {
+                double distX = _x[i] - x;
+                double distY = _y[i] - y;
+                double distanceSquared = distX * distX + distY * distY;
+                if (distanceSquared <= radiusSquared) {
+                    fn(_ids[i], distanceSquared);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * Implementation of the timing wheel. Tick t lives in slot t % kNumSlots, so
+ * a slot is reused once its tick has passed; whoever collects a tick's IDs
+ * empties the slot before anything is scheduled that far ahead again.
+ */
+#include "TimingWheel.h"
+#include "GUI/SimpleTest.h"
+using namespace std;
+
+void TimingWheel::schedule(long long tick, long long id) {
+    _slots[tick % kNumSlots].push_back(id);
+}
+
+vector<long long>& TimingWheel::due(long long tick) {
+    return _slots[tick % kNumSlots];
+}
+
+void TimingWheel::clear() {
+    for (vector<long long>& slot: _slots) {
+        slot.clear();
+    }
+}
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("timing wheel hands back IDs on the tick they were scheduled for") {
+    TimingWheel wheel;
+    wheel.schedule(1, 10);
+    wheel.schedule(3, 30);
+    wheel.schedule(1, 11);
+    wheel.schedule(TimingWheel::kNumSlots, 99);
+
+    EXPECT_EQUAL(int(wheel.due(1).size()), 2);
+    wheel.due(1).clear();
+    EXPECT_EQUAL(int(wheel.due(2).size()), 0);
+    EXPECT_EQUAL(int(wheel.due(3).size()), 1);
+    EXPECT_EQUAL(wheel.due(3)[0], 30);
+    wheel.due(3).clear();
+
+    /* The ring wraps around. */
+    wheel.schedule(TimingWheel::kNumSlots + 3, 31);
+    EXPECT_EQUAL(int(wheel.due(TimingWheel::kNumSlots).size()), 1);
+    EXPECT_EQUAL(wheel.due(TimingWheel::kNumSlots + 3)[0], 31);
+
+    wheel.clear();
+    EXPECT_EQUAL(int(wheel.due(TimingWheel::kNumSlots).size()), 0);
+}
@@ -0,0 +1,35 @@
+/******************************************************************************
+ * File: TimingWheel.h
+ *
+ * A timing wheel: a ring of buckets, one per upcoming tick, each holding the
+ * IDs of things that need attention on that tick. Scheduling something and
+ * collecting everything due on a tick both take constant time, however many
+ * things are waiting. Only the next kNumSlots ticks can be scheduled; things
+ * further off should be scheduled for the last tick in range and then
+ * rescheduled when that tick arrives.
+ */
+#pragma once
+
+#include <vector>
+
+class TimingWheel {
+public:
+    /* How many ticks ahead things can be scheduled. */
+    static const int kNumSlots = 256;
+
+    /* Schedules 'id' for the given tick, which must be after the last tick
+     * passed to due and less than kNumSlots ticks after it.
+     */
+    void schedule(long long tick, long long id);
+
+    /* Returns the IDs scheduled for the given tick, in no particular order.
+     * The caller should empty the list once it's done with it.
+     */
+    std::vector<long long>& due(long long tick);
+
+    /* Forgets everything that's scheduled. */
+    void clear();
+
+private:
+    std::vector<long long> _slots[kNumSlots];
+};
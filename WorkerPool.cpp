@@ -0,0 +1,180 @@
+/*
+ * Implementation of the worker pool. Each job is a range of task numbers;
+ * every thread (the caller included) repeatedly claims the next unclaimed
+ * task number until none are left. A task that throws ends the claiming
+ * early, and its exception is carried back to the caller of run.
+ */
+#include "WorkerPool.h"
+#include "GUI/SimpleTest.h"
+#include "error.h"
+using namespace std;
+
+WorkerPool::WorkerPool(int numThreads) {
+    _task = nullptr;
+    _numTasks = 0;
+    _nextTask = 0;
+    _numBusy = 0;
+    _generation = 0;
+    _stopping = false;
+
+    for (int i = 1; i < numThreads; i++) {
+        _threads.emplace_back([this] {
+            workerLoop();
+        });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+
+    for (thread& worker: _threads) {
+        worker.join();
+    }
+}
+
+int WorkerPool::numThreads() const {
+    return _threads.size() + 1;
+}
+
+void WorkerPool::run(int numTasks, const function<void (int)>& task) {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _task = &task;
+        _numTasks = numTasks;
+        _nextTask = 0;
+        _numBusy = _threads.size();
+        _generation++;
+    }
+    _wake.notify_all();
+
+    /* Pitch in rather than sitting idle. */
+    runTasks();
+
+    /* Every worker has to check in, even ones that found nothing left to
+     * do, before the next job can safely be posted.
+     */
+    unique_lock<mutex> lock(_mutex);
+    _done.wait(lock, [this] {
+        return _numBusy == 0;
+    });
+    _task = nullptr;
+
+    exception_ptr error = _error;
+    _error = nullptr;
+    lock.unlock();
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+void WorkerPool::runTasks() {
+    try {
+        for (int i = _nextTask++; i < _numTasks; i = _nextTask++) {
+            (*_task)(i);
+        }
+    }
+    catch (...) {
+        /* Keep the first exception, and leave nothing more to claim. */
+        lock_guard<mutex> lock(_mutex);
+        if (!_error) {
+            _error = current_exception();
+        }
+        _nextTask = _numTasks;
+    }
+}
+
+void WorkerPool::workerLoop() {
+    long seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> lock(_mutex);
+            _wake.wait(lock, [&] {
+                return _stopping || _generation != seen;
+            });
+            if (_stopping) return;
+            seen = _generation;
+        }
+
+        runTasks();
+
+        lock_guard<mutex> lock(_mutex);
+        _numBusy--;
+        if (_numBusy == 0) {
+            _done.notify_one();
+        }
+    }
+}
+
+/* * * * * Test Cases Below This Point * * * * */
+
+STUDENT_TEST("worker pool runs every task exactly once") {
+    WorkerPool pool(4);
+    EXPECT_EQUAL(pool.numThreads(), 4);
+
+    /* Several jobs in a row reuse the same threads. */
+    for (int round = 0; round < 20; round++) {
+        vector<atomic<int>> counts(1000);
+        pool.run(counts.size(), [&](int i) {
+            counts[i]++;
+        });
+
+        for (auto& count: counts) {
+            EXPECT_EQUAL(count.load(), 1);
+        }
+    }
+}
+
+STUDENT_TEST("single-thread worker pool runs tasks on the caller") {
+    WorkerPool pool(1);
+    EXPECT_EQUAL(pool.numThreads(), 1);
+
+    thread::id caller = this_thread::get_id();
+    int numRun = 0;
+    pool.run(10, [&](int) {
+        EXPECT_EQUAL(this_thread::get_id() == caller, true);
+        numRun++;
+    });
+    EXPECT_EQUAL(numRun, 10);
+}
+
+STUDENT_TEST("worker pool hands a task's exception back to the caller") {
+    WorkerPool pool(4);
+
+    /* Thrown on the calling thread. */
+    WorkerPool single(1);
+    EXPECT_ERROR(single.run(10, [&](int i) {
+        if (i == 3) error("Task failed");
+    }));
+
+    /* Thrown on a worker thread: the caller's task waits until a worker
+     * has thrown, so the caller can't end up running every task itself.
+     */
+    thread::id caller = this_thread::get_id();
+    atomic<bool> thrown(false);
+    EXPECT_ERROR(pool.run(100, [&](int) {
+        if (this_thread::get_id() == caller) {
+            while (!thrown) {
+                this_thread::yield();
+            }
+        }
+        else {
+            thrown = true;
+            error("Task failed");
+        }
+    }));
+
+    /* Both pools still work. */
+    for (WorkerPool* used: { &single, &pool }) {
+        vector<atomic<int>> counts(1000);
+        used->run(counts.size(), [&](int i) {
+            counts[i]++;
+        });
+        for (auto& count: counts) {
+            EXPECT_EQUAL(count.load(), 1);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * File: WorkerPool.h
+ *
+ * A small pool of worker threads for splitting a loop into independent
+ * tasks. The threads are started once and then sleep between jobs, so
+ * handing them a job every tick doesn't pay for creating threads.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+public:
+    /* Creates a pool that runs jobs on the given number of threads. The
+     * thread that calls run counts as one of them, so a pool of size one
+     * starts no extra threads at all.
+     */
+    explicit WorkerPool(int numThreads);
+
+    /* Stops and joins all of the worker threads. */
+    ~WorkerPool();
+
+    /* Number of threads, including the calling thread, that run jobs. */
+    int numThreads() const;
+
+    /* Calls task(i) for each i in [0, numTasks), spread across the threads
+     * in the pool, and returns once every call has finished. Tasks may run
+     * in any order and at the same time as one another.
+     *
+     * If a task throws, on any thread, the tasks that haven't started yet
+     * are skipped, the ones already running are allowed to finish, and then
+     * run throws the first exception on the calling thread. The pool can be
+     * used again afterward.
+     */
+    void run(int numTasks, const std::function<void (int)>& task);
+
+private:
+    std::vector<std::thread> _threads;
+
+    std::mutex _mutex;
+    std::condition_variable _wake; // Signaled when a new job is posted.
+    std::condition_variable _done; // Signaled when the last worker finishes a job.
+
+    /* The current job. */
+    const std::function<void (int)>* _task;
+    int _numTasks;
+    std::atomic<int> _nextTask;
+
+    int  _numBusy;    // Workers that haven't finished the current job
+    long _generation; // Bumped for each new job
+    bool _stopping;
+
+    /* The first exception thrown by a task in the current job, if any. */
+    std::exception_ptr _error;
+
+    void workerLoop();
+    void runTasks();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator= (const WorkerPool&) = delete;
+};